@@ -0,0 +1,108 @@
+#include "utils.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <print>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t operations = 200'000;
+constexpr size_t key_space = 4096;
+constexpr size_t capacity = 1024;
+// One insert per this many reads, roughly a miss being loaded
+constexpr size_t reads_per_insert = 9;
+
+using Value = std::shared_ptr<const std::string>;
+
+struct Result {
+  double mops_ = 0;
+  double hit_ratio_ = 0;
+  bool consistent_ = true;
+};
+
+std::vector<std::string> make_keys() {
+  std::vector<std::string> keys;
+  keys.reserve(key_space);
+  for (size_t i = 0; i < key_space; ++i) {
+    keys.push_back("/bench/directory_" + std::to_string(i));
+  }
+  return keys;
+}
+
+// Skewed towards low indices, like a few directories being revisited
+size_t skewed_index(std::mt19937_64 &random) {
+  std::uniform_real_distribution<double> uniform{0.0, 1.0};
+  auto sample = uniform(random);
+  return static_cast<size_t>(sample * sample * sample * key_space);
+}
+
+// Every thread reads and inserts a shared key set. Each value holds its own
+// key, so a torn read shows up as a mismatch.
+template <typename Cache>
+Result run(Cache &cache, const std::vector<std::string> &keys,
+           size_t thread_count) {
+  std::atomic<size_t> hits = 0;
+  std::atomic<bool> consistent = true;
+  auto start = std::chrono::steady_clock::now();
+  {
+    std::vector<std::jthread> threads;
+    for (size_t thread = 0; thread < thread_count; ++thread) {
+      threads.emplace_back([&, thread] {
+        std::mt19937_64 random{thread};
+        size_t local_hits = 0;
+        for (size_t i = 0; i < operations; ++i) {
+          const auto &key = keys[skewed_index(random)];
+          if (i % (reads_per_insert + 1) == reads_per_insert) {
+            cache.insert(key, std::make_shared<const std::string>(key));
+            continue;
+          }
+          if (auto value = cache.get(key)) {
+            ++local_hits;
+            if (*value.value() != key) {
+              consistent = false;
+            }
+          }
+        }
+        hits += local_hits;
+      });
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  auto seconds = std::chrono::duration<double>(end - start).count();
+  auto total = static_cast<double>(operations * thread_count);
+  auto reads = total * reads_per_insert / (reads_per_insert + 1);
+  return {.mops_ = total / seconds / 1e6,
+          .hit_ratio_ = static_cast<double>(hits.load()) / reads,
+          .consistent_ = consistent.load()};
+}
+
+} // namespace
+
+// Usage: cache_bench
+// Throughput of the listing cache shared between threads: 90% reads and 10%
+// inserts over a skewed key set larger than the cache. Lru is the exact,
+// single-lock cache; ShardedLru locks per shard and approximates recency.
+int main() {
+  auto keys = make_keys();
+  std::println("{:>7} {:>12} {:>8} {:>12} {:>8}", "threads", "Lru (Mops)",
+               "hits", "Sharded", "hits");
+  for (size_t threads : {1, 2, 4, 8}) {
+    duck::Lru<std::string, Value> lru{capacity};
+    duck::ShardedLru<std::string, Value> sharded{capacity};
+    auto exact = run(lru, keys, threads);
+    auto approximate = run(sharded, keys, threads);
+    if (!exact.consistent_ || !approximate.consistent_ ||
+        sharded.size() > sharded.capacity()) {
+      std::println(stderr, "inconsistent cache state");
+      return 1;
+    }
+    std::println("{:>7} {:>12.2f} {:>7.1f}% {:>12.2f} {:>7.1f}%", threads,
+                 exact.mops_, exact.hit_ratio_ * 100, approximate.mops_,
+                 approximate.hit_ratio_ * 100);
+  }
+  return 0;
+}
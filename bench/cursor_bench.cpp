@@ -0,0 +1,130 @@
+#include "app_state.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <print>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t moves = 1000;
+
+template <typename Fn> double time_us(Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+duck::Directory make_directory(const fs::path &path, size_t count) {
+  duck::Directory directory{.path_ = path};
+  for (size_t i = 0; i < count; ++i) {
+    // Every fifth entry hidden, like dotfiles in a home directory
+    directory.add_entry((i % 5 == 0 ? "." : "") + std::string{"entry_"} +
+                            std::to_string(i),
+                        i % 10 == 0 ? fs::file_type::directory
+                                    : fs::file_type::regular);
+  }
+  directory.sort();
+  return directory;
+}
+
+// The visible rows with hidden files shown as they were computed before
+// Directory kept a merged view, on every read
+std::vector<duck::Row> merge_per_call(const duck::Directory &directory) {
+  std::vector<duck::Row> rows;
+  rows.reserve(directory.entries_.size() + directory.hidden_entries_.size());
+  std::ranges::merge(directory.entries_, directory.hidden_entries_,
+                     std::back_inserter(rows),
+                     [&directory](duck::Row first, duck::Row second) {
+                       return directory.less(first, second);
+                     });
+  return rows;
+}
+
+} // namespace
+
+// Usage: cursor_bench
+// Per-keypress state work of a cursor move (j): the move itself, the entry
+// under the cursor for the preview and the directories nearby for the
+// prefetcher. Rendering is not included. The "by value" column repeats the
+// cache reads of that keypress on an Lru holding Directory values, which is
+// how the cache stored listings before. The second table moves with hidden
+// files shown, against merging the two row lists on each read.
+int main() {
+  fs::path path{"/bench"};
+  std::println("{:>9} {:>14} {:>14}", "entries", "shared (us)",
+               "by value (us)");
+  for (size_t count : {1'000, 10'000, 100'000, 1'000'000}) {
+    auto directory = make_directory(path, count);
+
+    duck::AppState state;
+    state.current_path_ = path;
+    state.cache_directory(directory);
+    size_t checksum = 0;
+    auto shared_us = time_us([&] {
+      for (size_t i = 0; i < moves; ++i) {
+        state.move_index_down();
+        checksum += state.indexed_entry().has_value();
+        checksum += state.nearby_directories(4, 32).size();
+      }
+    });
+
+    duck::Lru<fs::path, duck::Directory> by_value{1};
+    by_value.insert(path, directory);
+    auto by_value_us = time_us([&] {
+      for (size_t i = 0; i < moves; ++i) {
+        // entries_size, indexed_entry and nearby_directories each read the
+        // listing once
+        for (int read = 0; read < 3; ++read) {
+          checksum += by_value.get(path).value().entries_.size();
+        }
+      }
+    });
+
+    std::println("{:>9} {:>14.3f} {:>14.3f}", count, shared_us / moves,
+                 by_value_us / moves);
+    if (checksum == 0) {
+      return 1;
+    }
+  }
+
+  std::println("\nhidden files shown");
+  std::println("{:>9} {:>14} {:>14}", "entries", "merged (us)",
+               "per call (us)");
+  for (size_t count : {1'000, 10'000, 100'000, 1'000'000}) {
+    auto directory = make_directory(path, count);
+
+    duck::AppState state;
+    state.current_path_ = path;
+    state.show_hidden_ = true;
+    state.cache_directory(directory);
+    size_t checksum = 0;
+    auto merged_us = time_us([&] {
+      for (size_t i = 0; i < moves; ++i) {
+        state.move_index_down();
+        checksum += state.indexed_entry().has_value();
+        checksum += state.nearby_directories(4, 32).size();
+      }
+    });
+
+    auto per_call_us = time_us([&] {
+      for (size_t i = 0; i < moves; ++i) {
+        for (int read = 0; read < 3; ++read) {
+          checksum += merge_per_call(directory)[i % count];
+        }
+      }
+    });
+
+    std::println("{:>9} {:>14.3f} {:>14.3f}", count, merged_us / moves,
+                 per_call_us / moves);
+    if (checksum == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include "dir_reader.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <print>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+template <typename Fn> double time_ms(Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void populate(const fs::path &root, size_t count) {
+  fs::create_directories(root);
+  for (size_t i = 0; i < count; ++i) {
+    auto name = root / ("entry_" + std::to_string(i));
+    if (i % 10 == 0) {
+      fs::create_directory(name);
+    } else {
+      close(open(name.c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0644));
+    }
+  }
+}
+
+} // namespace
+
+// Usage: dir_reader_bench [entries] [directory]
+// Compares fs::directory_iterator + is_directory() against DirReader on the
+// given directory, or on a freshly populated temporary one.
+int main(int argc, char **argv) {
+  size_t count = argc > 1 ? std::stoul(argv[1]) : 400000;
+  auto populated = argc <= 2;
+  fs::path root = populated
+                      ? fs::temp_directory_path() / "duck_dir_reader_bench"
+                      : fs::path{argv[2]};
+  if (populated) {
+    fs::remove_all(root);
+    populate(root, count);
+  }
+
+  size_t iterator_dirs = 0;
+  auto iterator_ms = time_ms([&] {
+    for (const auto &entry : fs::directory_iterator(
+             root, fs::directory_options::skip_permission_denied)) {
+      iterator_dirs += static_cast<size_t>(fs::is_directory(entry.path()));
+    }
+  });
+
+  size_t reader_dirs = 0;
+  auto reader_ms = time_ms([&] {
+    duck::DirReader reader{root};
+    std::vector<duck::RawEntry> batch;
+    while (reader.next_batch(batch)) {
+      for (const auto &entry : batch) {
+        reader_dirs +=
+            static_cast<size_t>(entry.type_ == fs::file_type::directory);
+      }
+    }
+  });
+
+  std::println("directory_iterator: {:.2f} ms ({} dirs)", iterator_ms,
+               iterator_dirs);
+  std::println("getdents64 reader:  {:.2f} ms ({} dirs)", reader_ms,
+               reader_dirs);
+
+  if (populated) {
+    fs::remove_all(root);
+  }
+  return iterator_dirs == reader_dirs ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,90 @@
+#include "directory_table.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <malloc.h>
+#include <print>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+template <typename Fn> double time_ms(Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+size_t heap_in_use() {
+  auto info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+}
+
+std::string entry_name(size_t i) {
+  return "artifact_shard_" + std::to_string(i) + ".parquet";
+}
+
+} // namespace
+
+// Usage: directory_table_bench [entries]
+// Memory footprint and scan time of a listing held as
+// vector<fs::directory_entry> versus a DirectoryTable.
+int main(int argc, char **argv) {
+  size_t count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+  fs::path parent = "/data/datasets/artifacts/2024";
+
+  auto before = heap_in_use();
+  std::vector<fs::directory_entry> entries;
+  entries.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    entries.emplace_back(parent / entry_name(i));
+  }
+  auto entries_bytes = heap_in_use() - before;
+
+  before = heap_in_use();
+  duck::Directory directory{.path_ = parent};
+  for (size_t i = 0; i < count; ++i) {
+    directory.add_entry(entry_name(i), i % 10 == 0 ? fs::file_type::directory
+                                                   : fs::file_type::regular);
+  }
+  auto table_bytes = heap_in_use() - before;
+
+  size_t entries_sum = 0;
+  auto entries_ms = time_ms([&] {
+    for (const auto &entry : entries) {
+      entries_sum += entry.path().filename().native().size() +
+                     static_cast<size_t>(entry.is_directory());
+    }
+  });
+
+  size_t table_sum = 0;
+  auto table_ms = time_ms([&] {
+    for (auto entry : directory.table_.entries(directory.entries_)) {
+      table_sum +=
+          entry.name().size() + static_cast<size_t>(entry.is_directory());
+    }
+  });
+
+  auto entries_sort_ms = time_ms([&] {
+    std::ranges::sort(entries, [](const auto &first, const auto &second) {
+      if (first.is_directory() != second.is_directory()) {
+        return first.is_directory();
+      }
+      return first.path().filename() < second.path().filename();
+    });
+  });
+  auto table_sort_ms = time_ms([&] { directory.sort(); });
+
+  std::println("{} entries", count);
+  std::println("vector<directory_entry>: {:.1f} MiB, scan {:.2f} ms",
+               static_cast<double>(entries_bytes) / (1 << 20), entries_ms);
+  std::println("DirectoryTable:          {:.1f} MiB, scan {:.2f} ms",
+               static_cast<double>(table_bytes) / (1 << 20), table_ms);
+  std::println("sort: directory_entry {:.2f} ms, sort keys {:.2f} ms",
+               entries_sort_ms, table_sort_ms);
+  std::println("checksums {} {}", entries_sum, table_sum);
+}
@@ -0,0 +1,136 @@
+#include "image_preview.hpp"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <jpeglib.h>
+#include <png.h>
+#include <print>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t rounds = 10;
+constexpr std::uint32_t photo_width = 4000;
+constexpr std::uint32_t photo_height = 3000;
+// A 100x25 pane, two pixels per cell
+constexpr std::uint32_t box_width = 100;
+constexpr std::uint32_t box_height = 50;
+
+template <typename Fn> double time_ms(Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+std::vector<std::uint8_t> gradient() {
+  std::vector<std::uint8_t> rgba(size_t{photo_width} * photo_height * 4);
+  for (size_t y = 0; y < photo_height; ++y) {
+    for (size_t x = 0; x < photo_width; ++x) {
+      auto *pixel = rgba.data() + ((y * photo_width) + x) * 4;
+      pixel[0] = static_cast<std::uint8_t>(x * 255 / photo_width);
+      pixel[1] = static_cast<std::uint8_t>(y * 255 / photo_height);
+      pixel[2] = static_cast<std::uint8_t>((x + y) % 256);
+      pixel[3] = 0xff;
+    }
+  }
+  return rgba;
+}
+
+void write_png(const fs::path &path, const std::vector<std::uint8_t> &rgba) {
+  png_image png{};
+  png.version = PNG_IMAGE_VERSION;
+  png.width = photo_width;
+  png.height = photo_height;
+  png.format = PNG_FORMAT_RGBA;
+  png_image_write_to_file(&png, path.c_str(), 0, rgba.data(), 0, nullptr);
+}
+
+void write_jpeg(const fs::path &path, const std::vector<std::uint8_t> &rgba) {
+  jpeg_compress_struct info{};
+  jpeg_error_mgr errors{};
+  info.err = jpeg_std_error(&errors);
+  jpeg_create_compress(&info);
+  auto *file = std::fopen(path.c_str(), "wb");
+  jpeg_stdio_dest(&info, file);
+  info.image_width = photo_width;
+  info.image_height = photo_height;
+  info.input_components = 3;
+  info.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&info);
+  jpeg_start_compress(&info, TRUE);
+  std::vector<std::uint8_t> row(size_t{photo_width} * 3);
+  while (info.next_scanline < photo_height) {
+    const auto *pixels =
+        rgba.data() + size_t{info.next_scanline} * photo_width * 4;
+    for (size_t x = 0; x < photo_width; ++x) {
+      for (size_t channel = 0; channel < 3; ++channel) {
+        row[(x * 3) + channel] = pixels[(x * 4) + channel];
+      }
+    }
+    JSAMPROW rows = row.data();
+    jpeg_write_scanlines(&info, &rows, 1);
+  }
+  jpeg_finish_compress(&info);
+  jpeg_destroy_compress(&info);
+  std::fclose(file);
+}
+
+} // namespace
+
+// Usage: image_bench
+// Time to preview a 12 megapixel photo in a 100x25 pane: decoding at full
+// size and shrinking afterwards, against decode_image, which lets the JPEG
+// IDCT scale down first. The resize row shows the box filter alone.
+int main() {
+  auto root = fs::temp_directory_path() / "duck_image_bench";
+  fs::create_directories(root);
+  auto rgba = gradient();
+  auto png = root / "photo.png";
+  auto jpeg = root / "photo.jpg";
+  write_png(png, rgba);
+  write_jpeg(jpeg, rgba);
+  auto never = []() { return false; };
+
+  std::println("{:<8} {:>18} {:>18}", "file", "full size (ms)",
+               "decode_image (ms)");
+  for (auto [path, type] : {std::pair{jpeg, duck::ContentType::Jpeg},
+                            std::pair{png, duck::ContentType::Png}}) {
+    size_t checksum = 0;
+    auto full_ms = time_ms([&] {
+      for (size_t i = 0; i < rounds; ++i) {
+        auto image = duck::decode_image(path, type, photo_width,
+                                        photo_height, never);
+        auto [width, height] = duck::fit_size(image->width_, image->height_,
+                                              box_width, box_height);
+        checksum += duck::resize_image(*image, width, height).pixels_.size();
+      }
+    });
+    auto fitted_ms = time_ms([&] {
+      for (size_t i = 0; i < rounds; ++i) {
+        checksum +=
+            duck::decode_image(path, type, box_width, box_height, never)
+                ->pixels_.size();
+      }
+    });
+    std::println("{:<8} {:>18.1f} {:>18.1f}", path.extension().string(),
+                 full_ms / rounds, fitted_ms / rounds);
+    if (checksum == 0) {
+      return 1;
+    }
+  }
+
+  duck::Image image{.width_ = photo_width,
+                    .height_ = photo_height,
+                    .pixels_ = std::move(rgba)};
+  auto resize_ms = time_ms([&] {
+    for (size_t i = 0; i < rounds; ++i) {
+      duck::resize_image(image, box_width, box_width * 3 / 4);
+    }
+  });
+  std::println("{:<8} {:>18} {:>18.1f}", "resize", "", resize_ms / rounds);
+  fs::remove_all(root);
+  return 0;
+}
@@ -0,0 +1,93 @@
+#include "preview_reader.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <print>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t rounds = 50;
+constexpr size_t columns = 100;
+constexpr size_t rows = 50;
+
+template <typename Fn> double time_us(Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+// What FileManager::async_update_preview did before the preview reader
+std::string getline_preview(const fs::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::string content;
+  std::string line;
+  for (size_t i = 0; i < rows && std::getline(file, line); ++i) {
+    if (line.size() > columns) {
+      line = line.substr(0, columns) + "...";
+    }
+    content += line + '\n';
+  }
+  return content;
+}
+
+std::vector<fs::path> make_files(const fs::path &root) {
+  fs::create_directories(root);
+  std::vector<fs::path> files{root / "source.cpp", root / "unicode.md",
+                              root / "minified.json"};
+  std::ofstream source{files[0]};
+  for (int i = 0; i < 2000; ++i) {
+    source << "  int value_" << i << " = compute(" << i << "); // comment\n";
+  }
+  std::ofstream notes{files[1]};
+  for (int i = 0; i < 2000; ++i) {
+    notes << "- Ünïcödé line " << i << " with € and 日本語 "
+          << std::string(120, '=') << '\n';
+  }
+  // 64 MiB without a single newline
+  std::ofstream minified{files[2]};
+  std::string record = R"({"id":1,"name":"duck","tags":["a","b"]},)";
+  for (size_t written = 0; written < (size_t{64} << 20U);
+       written += record.size()) {
+    minified << record;
+  }
+  return files;
+}
+
+} // namespace
+
+// Usage: preview_bench
+// Time to build a 100x50 text preview: getline with substr as before, and
+// the bounded reader. The minified file shows getline reading everything
+// to show one line.
+int main() {
+  auto root = fs::temp_directory_path() / "duck_preview_bench";
+  auto files = make_files(root);
+
+  std::println("{:<14} {:>14} {:>14}", "file", "getline (us)",
+               "reader (us)");
+  for (const auto &file : files) {
+    size_t checksum = 0;
+    auto getline_us = time_us([&] {
+      for (size_t i = 0; i < rounds; ++i) {
+        checksum += getline_preview(file).size();
+      }
+    });
+    auto reader_us = time_us([&] {
+      for (size_t i = 0; i < rounds; ++i) {
+        checksum += duck::read_preview(file, columns, rows)->text_.size();
+      }
+    });
+    std::println("{:<14} {:>14.1f} {:>14.1f}", file.filename().string(),
+                 getline_us / rounds, reader_us / rounds);
+    if (checksum == 0) {
+      return 1;
+    }
+  }
+  fs::remove_all(root);
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include "utils.hpp"
+#include <fstream>
+#include <print>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+using Trace = std::vector<std::string>;
+
+constexpr size_t synthetic_steps = 20'000;
+constexpr size_t tree_depth = 4;
+constexpr size_t tree_fanout = 8;
+// Every scan_interval steps a bulk operation walks scan_length directories
+// that are never visited again, like reloading each destination of a paste
+constexpr size_t scan_interval = 500;
+constexpr size_t scan_length = 200;
+
+Trace read_trace(const std::string &file) {
+  Trace trace;
+  std::ifstream in{file};
+  for (std::string line; std::getline(in, line);) {
+    if (!line.empty()) {
+      trace.push_back(std::move(line));
+    }
+  }
+  return trace;
+}
+
+// Random walk over a directory tree: mostly in and out of nearby
+// directories, favouring the first children, with jumps back to a few
+// bookmarks.
+Trace navigation_trace(bool with_scans) {
+  std::mt19937_64 random{42};
+  std::geometric_distribution<size_t> child{0.35};
+  std::uniform_real_distribution<double> action{0.0, 1.0};
+  const std::vector<std::string> bookmarks{"/home/user", "/home/user/0/1",
+                                           "/home/user/2", "/etc"};
+  Trace trace;
+  std::string current = bookmarks.front();
+  size_t depth = 0;
+  size_t scans = 0;
+  for (size_t step = 0; step < synthetic_steps; ++step) {
+    if (with_scans && step % scan_interval == scan_interval - 1) {
+      for (size_t i = 0; i < scan_length; ++i) {
+        trace.push_back("/scan/" + std::to_string(scans) + "/" +
+                        std::to_string(i));
+      }
+      ++scans;
+    }
+    auto roll = action(random);
+    if (roll < 0.05) {
+      current = bookmarks[step % bookmarks.size()];
+      depth = 1;
+    } else if (roll < 0.5 && depth < tree_depth) {
+      current += "/" + std::to_string(child(random) % tree_fanout);
+      ++depth;
+    } else if (depth > 0) {
+      current.resize(current.rfind('/'));
+      --depth;
+    }
+    trace.push_back(current);
+  }
+  return trace;
+}
+
+// Demand caching: every access is a lookup, and a miss loads the listing.
+// First visits miss under any policy, so they are left out of the ratio.
+template <duck::Eviction policy>
+double hit_ratio(const Trace &trace, size_t capacity) {
+  duck::Lru<std::string, bool, policy> cache{capacity};
+  std::unordered_set<std::string> seen;
+  size_t hits = 0;
+  size_t revisits = 0;
+  for (const auto &path : trace) {
+    auto revisit = !seen.insert(path).second;
+    revisits += revisit ? 1 : 0;
+    if (cache.get(path)) {
+      ++hits;
+    } else {
+      cache.insert(path, true);
+    }
+  }
+  return revisits == 0 ? 0.0
+                       : static_cast<double>(hits) /
+                             static_cast<double>(revisits);
+}
+
+void replay(const std::string &name, const Trace &trace) {
+  for (size_t capacity : {16, 32, 64}) {
+    std::println("{:<20} {:>8} {:>9.1f}% {:>9.1f}%", name, capacity,
+                 hit_ratio<duck::Eviction::Lru>(trace, capacity) * 100,
+                 hit_ratio<duck::Eviction::TwoQueue>(trace, capacity) * 100);
+  }
+}
+
+} // namespace
+
+// Usage: replay_bench [trace...]
+// Replays directory access traces against the listing cache with each
+// eviction policy and prints the hit ratios of revisits. Traces hold one
+// path per line, as recorded by running duck with DUCK_TRACE=<file>.
+// Without arguments two synthetic traces are used, one with bulk scans
+// mixed in.
+int main(int argc, char *argv[]) {
+  std::println("{:<20} {:>8} {:>10} {:>10}", "trace", "capacity", "lru",
+               "2q");
+  if (argc > 1) {
+    for (int i = 1; i < argc; ++i) {
+      replay(argv[i], read_trace(argv[i]));
+    }
+    return 0;
+  }
+  replay("navigation", navigation_trace(false));
+  replay("navigation + scans", navigation_trace(true));
+  return 0;
+}
@@ -0,0 +1,96 @@
+#include "file_manager.hpp"
+#include "snapshot.hpp"
+#include <chrono>
+#include <fcntl.h>
+#include <filesystem>
+#include <memory>
+#include <print>
+#include <string>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+template <typename Fn> double time_ms(Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void populate(const fs::path &root, size_t count) {
+  fs::create_directories(root);
+  for (size_t i = 0; i < count; ++i) {
+    auto name = root / ("entry_" + std::to_string(i));
+    if (i % 10 == 0) {
+      fs::create_directory(name);
+    } else {
+      close(open(name.c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0644));
+    }
+  }
+}
+
+} // namespace
+
+// Usage: snapshot_bench [entries] [directories]
+// Startup cost of the cold path, which lists the start directory before the
+// first frame, against restoring it with a snapshot holding `directories`
+// listings. Both run with a warm dentry cache, so the cold figure is a lower
+// bound: on NFS or a cold disk the listing costs far more while the snapshot
+// stays one sequential read.
+int main(int argc, char **argv) {
+  size_t count = argc > 1 ? std::stoul(argv[1]) : 50000;
+  size_t directories = argc > 2 ? std::stoul(argv[2]) : 20;
+
+  auto root = fs::temp_directory_path() / "duck_snapshot_bench";
+  fs::remove_all(root);
+  auto start = root / "start";
+  populate(start, count);
+  for (size_t i = 1; i < directories; ++i) {
+    populate(root / ("other_" + std::to_string(i)), count / 10);
+  }
+
+  duck::Snapshot snapshot{.session_ = {.current_path_ = start}};
+  auto load = [](const fs::path &path) {
+    return std::make_shared<const duck::Directory>(
+        duck::FileManager::load_directory(path));
+  };
+  snapshot.directories_.push_back(load(start));
+  for (size_t i = 1; i < directories; ++i) {
+    snapshot.directories_.push_back(
+        load(root / ("other_" + std::to_string(i))));
+  }
+  auto file = root / "snapshot";
+  auto write_ms = time_ms([&] { duck::write_snapshot(file, snapshot); });
+
+  size_t cold_rows = 0;
+  auto cold_ms = time_ms([&] {
+    cold_rows = duck::FileManager::load_directory(start).table_.size();
+  });
+
+  size_t restored_rows = 0;
+  auto snapshot_ms = time_ms([&] {
+    auto restored = duck::read_snapshot(file);
+    restored_rows = restored.value().directories_.front()->table_.size();
+  });
+
+  size_t stale = 0;
+  auto revalidate_ms = time_ms([&] {
+    for (const auto &directory : snapshot.directories_) {
+      stale += duck::stamp_directory(directory->path_) != directory->stamp_;
+    }
+  });
+
+  std::println("start directory: {} entries, snapshot: {} directories, {} KiB",
+               count, directories, fs::file_size(file) / 1024);
+  std::println("cold listing:      {:.2f} ms", cold_ms);
+  std::println("snapshot restore:  {:.2f} ms (all {} directories)",
+               snapshot_ms, directories);
+  std::println("revalidation:      {:.2f} ms in the background, {} stale",
+               revalidate_ms, stale);
+  std::println("snapshot write:    {:.2f} ms on exit", write_ms);
+
+  fs::remove_all(root);
+  return cold_rows == restored_rows ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+#include "sniffer.hpp"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <print>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t rounds = 200;
+
+template <typename Fn> double time_us(Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+// What FileManager::get_mime did before the in-process sniffer
+std::string popen_mime(const fs::path &path) {
+  std::array<char, 256> buffer{};
+  std::string cmd = "file -b --mime-type '" + path.string() + "'";
+  std::unique_ptr<FILE, int (*)(FILE *)> pipe(popen(cmd.c_str(), "r"),
+                                              pclose);
+  if (!pipe || fgets(buffer.data(), buffer.size(), pipe.get()) == nullptr) {
+    return {};
+  }
+  return {buffer.data()};
+}
+
+std::vector<fs::path> make_files(const fs::path &root) {
+  fs::create_directories(root);
+  std::vector<fs::path> files{root / "source.cpp", root / "notes.md",
+                              root / "image.png", root / "blob.bin"};
+  {
+    std::ofstream source{files[0]};
+    for (int i = 0; i < 500; ++i) {
+      source << "int value_" << i << " = " << i << "; // comment\n";
+    }
+    std::ofstream notes{files[1]};
+    for (int i = 0; i < 200; ++i) {
+      notes << "- Ünïcödé line " << i << " with some € and ❄\n";
+    }
+    std::ofstream image{files[2], std::ios::binary};
+    image << "\x89PNG\r\n\x1a\n" << std::string(4096, '\x11');
+    std::ofstream blob{files[3], std::ios::binary};
+    for (int i = 0; i < 8192; ++i) {
+      blob.put(static_cast<char>(i * 31));
+    }
+  }
+  return files;
+}
+
+} // namespace
+
+// Usage: sniffer_bench
+// Per-file cost of telling text from binary for the preview: popen of
+// file(1) as before, the in-process sniffer with an empty cache, and the
+// sniffer again once the result is cached by file identity.
+int main() {
+  auto root = fs::temp_directory_path() / "duck_sniffer_bench";
+  auto files = make_files(root);
+
+  std::println("{:<12} {:>12} {:>12} {:>12}", "file", "popen (us)",
+               "sniff (us)", "cached (us)");
+  for (const auto &file : files) {
+    size_t checksum = 0;
+    auto popen_us = time_us([&] {
+      for (size_t i = 0; i < rounds / 10; ++i) {
+        checksum += popen_mime(file).size();
+      }
+    });
+    auto sniff_us = time_us([&] {
+      for (size_t i = 0; i < rounds; ++i) {
+        duck::ContentSniffer sniffer;
+        checksum += static_cast<size_t>(sniffer.sniff(file));
+      }
+    });
+    duck::ContentSniffer sniffer;
+    sniffer.sniff(file);
+    auto cached_us = time_us([&] {
+      for (size_t i = 0; i < rounds; ++i) {
+        checksum += static_cast<size_t>(sniffer.sniff(file));
+      }
+    });
+    std::println("{:<12} {:>12.1f} {:>12.1f} {:>12.1f}",
+                 file.filename().string(), popen_us / (rounds / 10.0),
+                 sniff_us / rounds, cached_us / rounds);
+    if (checksum == 0) {
+      return 1;
+    }
+  }
+  fs::remove_all(root);
+  return 0;
+}
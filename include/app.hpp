@@ -2,12 +2,23 @@
 #include "app_event.hpp"
 #include "app_state.hpp"
 #include "event_bus.hpp"
+#include "prefetcher.hpp"
 #include "ui.hpp"
+#include "watcher.hpp"
 #include <ftxui/dom/elements.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
 #include <thread>
+#include <utility>
 
 namespace duck {
 
+// Quiet time after the last cursor move before the preview follows it
+constexpr auto preview_settle_interval = std::chrono::milliseconds{40};
+
 class FileManager; // Forward declaration
 
 class App {
@@ -16,27 +27,57 @@ private:
   EventBus &event_bus_;
   Ui &ui_;
   FileManager &file_manager_;
+  Watcher &watcher_;
+  Prefetcher &prefetcher_;
   std::jthread event_processing_thread_;
   bool running_ = false;
+  std::chrono::steady_clock::duration startup_time_{};
+  bool restored_from_snapshot_ = false;
+  // Directories opened or previewed, one per line, when DUCK_TRACE names a
+  // file. cache_bench replays these.
+  std::ofstream trace_;
+  // Set while the cursor is moving, cleared by update_preview()
+  std::optional<std::chrono::steady_clock::time_point> preview_due_;
+  // Hex dump offset set by the jump dialog, kept while its file is shown
+  std::optional<std::pair<fs::path, std::uint64_t>> preview_offset_;
+  // Directory being streamed in until one of its chunks or its listing
+  // arrives. Whichever comes first switches the view, since the event bus
+  // may drop any of them.
+  std::optional<fs::path> entering_;
+  // Directory shown from its chunks while the rest of it loads
+  std::optional<fs::path> streaming_;
 
   void process_events();
+  void restore_snapshot();
+  void save_snapshot();
   void handle_fmgr_event(const FmgrEvent &event);
   void handle_render_event(const RenderEvent &event);
   void handle_directory_loaded(const DirecotryLoaded &event);
+  void handle_directory_chunk(const DirectoryChunk &event);
+  void handle_directory_changed(const DirectoryChanged &event);
   void handle_preview_updated(const TextPreview &event);
 
   void update_current_direcotry(const fs::path &path);
-  void move_index_down();
-  void move_index_up();
+  void start_entering(const fs::path &path);
+  void cancel_entering();
+  void update_watches();
+  void revalidate(const fs::path &path);
+  void schedule_prefetch();
+  void record_access(const fs::path &path, bool cached);
+  std::ptrdiff_t navigation_delta(const RenderEvent &event);
+  void move_index(std::ptrdiff_t delta);
+  void settle_cursor();
   void toggle_selection();
   void update_preview();
   void refresh_menu();
   void toggle_hidden();
+  void cycle_sort_mode();
   void enter_directory();
   void leave_directory();
   void confirm_deletion();
   void confirm_creation();
   void confirm_rename();
+  void confirm_jump();
   void paste_selected_entries();
   void start_yank();
   void start_cut();
@@ -44,14 +85,22 @@ private:
   void toggle_creation_dialog();
   void toggle_rename_dialog();
   void toggle_notification();
+  void toggle_jump_dialog();
   void clear_marks();
   void open_file();
 
 public:
-  App(EventBus &event_bus, Ui &ui, FileManager &file_manager);
+  App(EventBus &event_bus, Ui &ui, FileManager &file_manager,
+      Watcher &watcher, Prefetcher &prefetcher);
 
   void run();
 
+  // Time from launch until the first listing was ready to render
+  [[nodiscard]] std::chrono::steady_clock::duration startup_time() const;
+  [[nodiscard]] bool restored_from_snapshot() const;
+  [[nodiscard]] RevalidationStats revalidation_stats() const;
+  [[nodiscard]] CacheStats cache_stats();
+
   void stop();
 };
 
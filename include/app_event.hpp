@@ -1,7 +1,12 @@
 #pragma once
+#include "highlighter.hpp"
+#include "image_preview.hpp"
+#include "preview_reader.hpp"
 #include "utils.hpp"
 #include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <optional>
 #include <ftxui/dom/elements.hpp>
 #include <string>
 #include <variant>
@@ -11,8 +16,22 @@ namespace duck {
 
 namespace fs = std::filesystem;
 
-using EntryPreview = std::variant<std::string, ftxui::Element, std::monostate>;
-using MenuInfo = std::tuple<std::string, size_t, std::vector<ftxui::Element>>;
+using EntryPreview =
+    std::variant<std::string, ftxui::Element, TextLinesPtr,
+                 HighlightedLinesPtr, ImagePtr, std::monostate>;
+// Rows of the left pane. Elements are built on demand, only for the rows in
+// view; `row_` holds what it needs by value, so the UI thread can call it
+// while the event thread moves on.
+struct MenuRows {
+  size_t size_ = 0;
+  std::function<ftxui::Element(size_t)> row_;
+};
+
+using MenuInfo = std::tuple<std::string, size_t, MenuRows>;
+
+// Numbers requests of one kind in the order they were made. Results carry
+// the epoch of their request and are dropped unless it is the latest.
+using Epoch = std::uint64_t;
 
 struct FmgrEvent {
   enum class Type : std::uint8_t {
@@ -28,6 +47,8 @@ struct FmgrEvent {
     Paste,
     Yank,
     Cut,
+    CycleSortMode,
+    JumpToOffset,
   } type_;
   fs::path path;
   fs::path path_to;
@@ -47,22 +68,60 @@ struct RenderEvent {
     ToggleDeletionDialog,
     ToggleRenameDialog,
     ToggleCreationDialog,
+    ToggleJumpDialog,
     ClearMarks,
     Quit,
   } type_;
 };
 
 struct TextPreview {
-  std::string preview_;
+  EntryPreview preview_;
+  Epoch epoch_ = 0;
 };
 
 struct DirecotryLoaded {
   bool update_preview_ = false;
+  // Replaces a listing the view may be showing, such as the final sorted
+  // listing of a streamed directory, without moving the cursor
+  bool keep_focus_ = false;
+  // Speculative load, dropped if the directory got cached meanwhile
+  bool prefetched_ = false;
+  // Preview request the load was made for, with `update_preview_`, or the
+  // directory entered, with `keep_focus_`
+  Epoch epoch_ = 0;
   Directory directory_;
 };
 
+struct DirectoryChunk {
+  fs::path path_;
+  DirectoryTable table_;
+  // Of the async_enter_directory() call that streamed it
+  Epoch epoch_ = 0;
+};
+
+struct FsChange {
+  enum class Type : std::uint8_t { Created, Deleted, Renamed, Modified } type_;
+  std::string name_;
+  std::string new_name_;
+  fs::file_type file_type_ = fs::file_type::none;
+  bool is_symlink_ = false;
+  std::uint64_t size_ = 0;
+  std::int64_t mtime_ = 0;
+};
+
+// Debounced batch of changes to one watched directory. `overflow_` means
+// the kernel dropped events and the listing has to be reloaded.
+struct DirectoryChanged {
+  fs::path path_;
+  std::vector<FsChange> changes_;
+  bool overflow_ = false;
+  // Taken after the changes were read, later ones arrive in the next batch
+  std::optional<DirectoryStamp> stamp_;
+};
+
 using AppEvent =
-    std::variant<FmgrEvent, RenderEvent, DirecotryLoaded, TextPreview>;
+    std::variant<FmgrEvent, RenderEvent, DirecotryLoaded, DirectoryChunk,
+                 DirectoryChanged, TextPreview>;
 
 template <typename... Ts> struct Visitor : Ts... {
   using Ts::operator()...;
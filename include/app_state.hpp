@@ -1,51 +1,121 @@
 #pragma once
+#include "app_event.hpp"
 #include "utils.hpp"
+#include <chrono>
+#include <cstddef>
 #include <filesystem>
+#include <memory>
 #include <ftxui/dom/elements.hpp>
 #include <ftxui/dom/node.hpp>
 #include <optional>
 #include <set>
+#include <span>
+#include <unordered_map>
 #include <vector>
 
 namespace duck {
 namespace fs = std::filesystem;
 
-constexpr size_t lru_cache_size = 50;
+// Count ceiling, the byte budget is what normally bounds the cache
+constexpr size_t lru_cache_size = 512;
+// Overridden in MiB by DUCK_CACHE_MB
+constexpr size_t default_cache_budget = size_t{256} << 20U;
+// PSI "some avg10" above which half the cache is dropped
+constexpr double memory_pressure_threshold = 10.0;
+constexpr auto memory_pressure_interval = std::chrono::seconds{2};
+// A cached listing is checked against the filesystem at most this often
+constexpr auto revalidation_interval = std::chrono::seconds{1};
+
+struct CacheStats {
+  size_t bytes_ = 0;
+  size_t budget_ = 0;
+  size_t sheds_ = 0;
+};
+
+struct RevalidationStats {
+  size_t revalidations_ = 0;
+  size_t stale_hits_ = 0;
+  size_t rate_limited_ = 0;
+};
 
 struct AppState {
   fs::path current_path_;
   fs::path previous_path_;
 
-  Directory current_directory_;
-  std::set<fs::directory_entry> selected_entries_;
+  DirectoryPtr current_directory_;
+  std::set<Entry> selected_entries_;
 
   bool is_yanking_ = false;
   bool is_cutting_ = false;
   bool show_hidden_ = false;
+  // Applied to newly loaded directories, cached ones keep their own
+  SortMode sort_mode_ = SortMode::Name;
 
   size_t index_ = 0;
 
   // UI state
 
   // Cache
-  Lru<fs::path, Directory> cache_;
+  Lru<fs::path, DirectoryPtr, Eviction::TwoQueue> cache_;
+  std::unordered_map<fs::path, std::chrono::steady_clock::time_point>
+      revalidated_at_;
+  RevalidationStats revalidation_stats_;
+  std::chrono::steady_clock::time_point pressure_checked_at_;
+  size_t sheds_ = 0;
 
   AppState();
 
+  void cache_directory(Directory directory);
+  // Keeps the listings on screen, the current directory and its parent,
+  // from being evicted
+  void pin_current();
+  void shed_under_pressure();
+  CacheStats cache_stats();
+  // Copy-on-write update of a cached listing, readers holding the previous
+  // snapshot keep it unchanged. Returns false if `path` isn't cached.
+  template <typename Fn> bool update_directory(const fs::path &path, Fn &&fn) {
+    auto cached = cache_.get(path);
+    if (!cached) {
+      return false;
+    }
+    auto directory = *cached.value();
+    fn(directory);
+    cache_.insert(path,
+                  std::make_shared<const Directory>(std::move(directory)));
+    return true;
+  }
+
+  ftxui::Element entry_element(const Directory &directory, Row row) const;
   std::vector<ftxui::Element>
-  entries_to_elements(const std::vector<fs::directory_entry> &entries) const;
-  std::vector<ftxui::Element> current_directory_elements();
+  entries_to_elements(const Directory &directory,
+                      std::span<const Row> rows) const;
+  std::optional<std::vector<ftxui::Element>>
+  directory_elements(const fs::path &path, size_t limit);
+  MenuRows current_rows();
   std::vector<ftxui::Element> selected_entries_elements();
   size_t entries_size(const fs::path &path);
-  std::optional<std::vector<fs::directory_entry>>
-  get_entries(const fs::path &path);
+  std::span<const Row> visible_rows(const Directory &directory) const;
+  size_t visible_count(const Directory &directory) const;
+  std::optional<Row> visible_row(const Directory &directory,
+                                 size_t index) const;
   std::vector<fs::path> selected_entries_paths();
-  std::optional<fs::directory_entry> indexed_entry();
+  std::vector<fs::path> nearby_directories(size_t count, size_t scan_rows);
+  std::optional<Entry> indexed_entry();
+  // Moves the cursor `delta` rows, wrapping around either end
+  void move_index(std::ptrdiff_t delta);
   void move_index_down();
   void move_index_up();
   void toggle_hidden();
+  bool focus_entry(const fs::path &path);
+  void merge_entries(const fs::path &path, const DirectoryTable &chunk);
+  void commit_directory(Directory directory);
+  void sort_directory(const fs::path &path, SortMode mode);
   void remove_entries(const std::vector<fs::path> &paths);
   void rename_entry(const fs::path &old_name, const fs::path &new_name);
-  void create_entry(const fs::path &new_entry);
+  void create_entry(const fs::path &new_entry, bool is_directory);
+  void apply_changes(const fs::path &path,
+                     const std::vector<FsChange> &changes,
+                     std::optional<DirectoryStamp> stamp);
+  bool is_stale(const fs::path &path);
 };
 } // namespace duck
@@ -0,0 +1,57 @@
+#pragma once
+#include "preview_reader.hpp"
+#include "sniffer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace duck {
+
+namespace fs = std::filesystem;
+
+// Bytes read at a time: from a central directory, or of gzip input
+constexpr size_t archive_read_size = size_t{64} << 10U;
+// Larger GNU long names and pax headers end the listing
+constexpr size_t tar_meta_limit = size_t{1} << 20U;
+
+struct ArchiveEntry {
+  std::string name_;
+  std::uint64_t size_ = 0;
+  bool is_directory_ = false;
+};
+
+struct ArchiveListing {
+  std::vector<ArchiveEntry> entries_;
+  // Entries in the whole archive, when known without reading all of it
+  std::optional<std::uint64_t> total_;
+};
+
+// Zip files and tarballs, plain or gzipped
+bool is_archive(ContentType type);
+
+// The first `limit` entries of the central directory at the end of a zip,
+// zip64 included. Only the end record and those entries are read.
+std::optional<ArchiveListing> list_zip(const fs::path &path, size_t limit,
+                                       const std::function<bool()> &stopped);
+
+// The first `limit` entries of a tar, inflated on the fly if `gzipped`.
+// Payloads in between are seeked over, or inflated and dropped. Nullopt if
+// the first header is not a tar header.
+std::optional<ArchiveListing> list_tar(const fs::path &path, bool gzipped,
+                                       size_t limit,
+                                       const std::function<bool()> &stopped);
+
+// Nullopt for a broken archive, or gzip around something other than a tar
+std::optional<ArchiveListing>
+list_archive(const fs::path &path, ContentType type, size_t limit,
+             const std::function<bool()> &stopped);
+
+// The entry count, then a line per entry: its size and its name
+TextLines archive_lines(const ArchiveListing &listing, size_t columns,
+                        size_t rows);
+
+} // namespace duck
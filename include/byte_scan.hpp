@@ -0,0 +1,77 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace duck {
+
+// Position of the first `byte` in `bytes` at or after `from`, or
+// bytes.size(). Sixteen bytes per step with SSE2.
+inline size_t find_byte(std::string_view bytes, char byte, size_t from = 0) {
+  auto i = from;
+#if defined(__SSE2__)
+  auto needle = _mm_set1_epi8(byte);
+  for (; i + 16 <= bytes.size(); i += 16) {
+    auto block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes.data() + i));
+    auto mask = static_cast<unsigned>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+    if (mask != 0) {
+      return i + static_cast<size_t>(std::countr_zero(mask));
+    }
+  }
+#endif
+  for (; i < bytes.size(); ++i) {
+    if (bytes[i] == byte) {
+      return i;
+    }
+  }
+  return bytes.size();
+}
+
+// Whether every byte is printable ASCII, 0x20 to 0x7e, so that each one
+// takes exactly one column. Eight or sixteen bytes at a time.
+inline bool is_printable_ascii(std::string_view bytes) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 16 <= bytes.size(); i += 16) {
+    auto block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes.data() + i));
+    // Signed compare: bytes from 0x80 up are below 0x20 here too
+    auto rejected = _mm_or_si128(_mm_cmplt_epi8(block, _mm_set1_epi8(0x20)),
+                                 _mm_cmpeq_epi8(block, _mm_set1_epi8(0x7f)));
+    if (_mm_movemask_epi8(rejected) != 0) {
+      return false;
+    }
+  }
+#endif
+  constexpr std::uint64_t ones = 0x0101010101010101ULL;
+  constexpr std::uint64_t high_bits = 0x8080808080808080ULL;
+  for (; i + sizeof(std::uint64_t) <= bytes.size();
+       i += sizeof(std::uint64_t)) {
+    std::uint64_t word = 0;
+    std::memcpy(&word, bytes.data() + i, sizeof(word));
+    // High bit set, below 0x20, or 0x7f once xored to zero
+    auto deleted = word ^ (ones * 0x7f);
+    if (((word | ((word - ones * 0x20) & ~word) |
+          ((deleted - ones) & ~deleted)) &
+         high_bits) != 0) {
+      return false;
+    }
+  }
+  for (; i < bytes.size(); ++i) {
+    auto byte = static_cast<unsigned char>(bytes[i]);
+    if (byte < 0x20 || byte >= 0x7f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace duck
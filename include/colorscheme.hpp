@@ -50,6 +50,14 @@ private:
               {"warning", CatppuccinFrappe.Yellow},
               {"file", CatppuccinFrappe.Text},
               {"dir", CatppuccinFrappe.Rosewater},
+              {"keyword", CatppuccinFrappe.Mauve},
+              {"string", CatppuccinFrappe.Green},
+              {"number", CatppuccinFrappe.Peach},
+              {"comment", CatppuccinFrappe.Overlay1},
+              {"preprocessor", CatppuccinFrappe.Pink},
+              {"key", CatppuccinFrappe.Blue},
+              {"heading", CatppuccinFrappe.Red},
+              {"code", CatppuccinFrappe.Teal},
           };
 
   ColorScheme() = default;
@@ -68,6 +76,15 @@ public:
   static ftxui::Color warning();
   static ftxui::Color file();
   static ftxui::Color dir();
+  // Syntax highlighting
+  static ftxui::Color keyword();
+  static ftxui::Color string();
+  static ftxui::Color number();
+  static ftxui::Color comment();
+  static ftxui::Color preprocessor();
+  static ftxui::Color key();
+  static ftxui::Color heading();
+  static ftxui::Color code();
 };
 
 } // namespace duck
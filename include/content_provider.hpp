@@ -14,9 +14,11 @@ namespace fs = std::filesystem;
 
 class ContentProvider {
 private:
-  static ftxui::Element
-  visible_entries(const std::vector<ftxui::Element> &all_entries,
-                  const size_t &index);
+  static ftxui::Element visible_entries(const MenuRows &rows,
+                                        const size_t &index);
+  static ftxui::Element text_lines(const TextLines &lines);
+  static ftxui::Element highlighted_lines(const HighlightedLines &lines);
+  static ftxui::Element image_cells(const ImagePtr &image);
   ftxui::Element left_pane(const MenuInfo &info);
   ftxui::Element right_pane(const EntryPreview &preview);
 
@@ -30,6 +32,7 @@ public:
                                  std::string &rename_input);
   ftxui::Component creation_dialog(int &cursor_position,
                                    std::string &new_entry_input);
+  ftxui::Component jump_dialog(int &cursor_position, std::string &offset_input);
   ftxui::Component notification(std::string &content);
   ftxui::Component layout(const MenuInfo &info, const EntryPreview &preview);
 };
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+#include <sys/types.h>
+#include <system_error>
+#include <vector>
+
+namespace duck {
+
+namespace fs = std::filesystem;
+
+constexpr size_t dir_reader_buffer_size = 1 << 20;
+
+fs::file_type mode_to_type(mode_t mode);
+
+struct RawEntry {
+  std::string_view name_;
+  fs::file_type type_ = fs::file_type::none;
+  bool is_symlink_ = false;
+};
+
+// Reads a directory in bulk with getdents64 and classifies entries from
+// d_type alone. fstatat is only issued for DT_UNKNOWN entries and to resolve
+// the target of symlinks.
+class DirReader {
+private:
+  int fd_ = -1;
+  std::error_code error_;
+  std::vector<std::byte> buffer_;
+
+public:
+  explicit DirReader(const fs::path &path,
+                     size_t buffer_size = dir_reader_buffer_size);
+  ~DirReader();
+
+  DirReader(const DirReader &) = delete;
+  DirReader &operator=(const DirReader &) = delete;
+  DirReader(DirReader &&) = delete;
+  DirReader &operator=(DirReader &&) = delete;
+
+  [[nodiscard]] bool is_open() const;
+  [[nodiscard]] std::error_code error() const;
+
+  // Replaces the contents of `batch` with the next buffer of entries, "." and
+  // ".." excluded. Names point into the reader's buffer and stay valid until
+  // the next call. Returns false once the directory is exhausted.
+  bool next_batch(std::vector<RawEntry> &batch);
+};
+
+} // namespace duck
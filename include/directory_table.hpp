@@ -0,0 +1,209 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace duck {
+
+namespace fs = std::filesystem;
+
+using Row = std::uint32_t;
+
+enum class SortMode : std::uint8_t { Name, Size, Mtime, Extension, Natural };
+
+constexpr size_t sort_mode_count = 5;
+
+constexpr bool needs_metadata(SortMode mode) {
+  return mode == SortMode::Size || mode == SortMode::Mtime;
+}
+
+// Extension including the dot, empty for dotfiles and names without one.
+constexpr std::string_view name_extension(std::string_view name) {
+  auto dot = name.rfind('.');
+  if (dot == std::string_view::npos || dot == 0) {
+    return {};
+  }
+  return name.substr(dot);
+}
+
+// What an entry is as far as its type and name tell, so the icon can be
+// picked without looking at the file.
+enum class FileClass : std::uint8_t {
+  Missing,
+  Directory,
+  Other,
+  Text,
+  Markdown,
+  CppSource,
+  CppHeader,
+  CSource,
+  Image,
+  Gif,
+  Pdf,
+  Archive,
+  Audio,
+  Video,
+  Json,
+  Log,
+  Csv,
+};
+
+constexpr size_t file_class_count = 17;
+
+FileClass classify(std::string_view name, fs::file_type type);
+
+class DirectoryTable;
+
+// Non-owning handle to one row of a DirectoryTable, cheap to copy and never
+// touches the filesystem.
+class EntryView {
+private:
+  const DirectoryTable *table_;
+  Row row_;
+
+public:
+  EntryView(const DirectoryTable &table, Row row)
+      : table_{&table}, row_{row} {}
+
+  [[nodiscard]] Row row() const { return row_; }
+  [[nodiscard]] std::string_view name() const;
+  [[nodiscard]] fs::file_type type() const;
+  [[nodiscard]] bool is_directory() const;
+  [[nodiscard]] bool is_symlink() const;
+  [[nodiscard]] bool is_hidden() const;
+  [[nodiscard]] bool exists() const;
+};
+
+constexpr size_t parallel_sort_threshold = 1 << 15;
+
+// Columnar storage for the entries of one directory. Names live back to back
+// in a single arena, type and flags share one byte per row and file metadata
+// is only stored once something asks for it.
+//
+// Rows are ordered through one 64-bit key per row and sort mode: the
+// directory bit followed by the leading bytes of whatever the mode sorts on,
+// so ordering rows rarely needs to look at the names themselves. Name keys
+// are computed on append, the other modes the first time they are used.
+class DirectoryTable {
+private:
+  static constexpr std::uint8_t type_mask = 0x0f;
+  static constexpr std::uint8_t hidden_flag = 0x10;
+  static constexpr std::uint8_t symlink_flag = 0x20;
+
+  std::string names_;
+  std::vector<std::uint32_t> name_offsets_{0};
+  std::vector<std::uint8_t> kinds_;
+  // Derived from names and kinds on append, never stored
+  std::vector<FileClass> classes_;
+  std::array<std::vector<std::uint64_t>, sort_mode_count> sort_keys_;
+  std::uint8_t key_modes_ = 1U << static_cast<unsigned>(SortMode::Name);
+  std::vector<std::uint64_t> sizes_;
+  std::vector<std::int64_t> mtimes_;
+
+  [[nodiscard]] std::uint64_t compute_key(Row row, SortMode mode) const;
+  [[nodiscard]] bool tie_less(Row first, Row second, SortMode mode) const;
+
+public:
+  Row append(std::string_view name, fs::file_type type,
+             bool is_symlink = false);
+  void reserve(size_t rows, size_t name_bytes);
+
+  [[nodiscard]] size_t size() const { return kinds_.size(); }
+  [[nodiscard]] bool empty() const { return kinds_.empty(); }
+
+  [[nodiscard]] std::string_view name(Row row) const {
+    return {names_.data() + name_offsets_[row],
+            name_offsets_[row + 1] - name_offsets_[row]};
+  }
+  [[nodiscard]] fs::file_type type(Row row) const;
+  [[nodiscard]] bool is_directory(Row row) const {
+    return type(row) == fs::file_type::directory;
+  }
+  [[nodiscard]] bool is_symlink(Row row) const {
+    return (kinds_[row] & symlink_flag) != 0;
+  }
+  [[nodiscard]] bool is_hidden(Row row) const {
+    return (kinds_[row] & hidden_flag) != 0;
+  }
+  [[nodiscard]] FileClass file_class(Row row) const { return classes_[row]; }
+
+  [[nodiscard]] bool has_metadata() const { return !sizes_.empty(); }
+  void set_metadata(Row row, std::uint64_t size_bytes, std::int64_t mtime_ns);
+  [[nodiscard]] std::uint64_t file_size(Row row) const { return sizes_[row]; }
+  [[nodiscard]] std::int64_t mtime(Row row) const { return mtimes_[row]; }
+
+  [[nodiscard]] bool has_keys(SortMode mode) const {
+    return (key_modes_ & (1U << static_cast<unsigned>(mode))) != 0;
+  }
+  void ensure_keys(SortMode mode);
+
+  // Directories first, then by the mode's key. Requires has_keys(mode).
+  [[nodiscard]] bool less(Row first, Row second,
+                          SortMode mode = SortMode::Name) const {
+    const auto &keys = sort_keys_[static_cast<size_t>(mode)];
+    if (keys[first] != keys[second]) {
+      return keys[first] < keys[second];
+    }
+    return tie_less(first, second, mode);
+  }
+  void sort(std::span<Row> rows, SortMode mode = SortMode::Name) const;
+  void insert_sorted(std::vector<Row> &rows, Row row,
+                     SortMode mode = SortMode::Name) const;
+
+  [[nodiscard]] EntryView entry(Row row) const { return {*this, row}; }
+  [[nodiscard]] auto entries(std::span<const Row> rows) const {
+    return rows | std::views::transform(
+                      [this](Row row) { return EntryView{*this, row}; });
+  }
+
+  // A table of only `rows`, in that order: row i of the result is rows[i]
+  // here, with its metadata and sort keys
+  [[nodiscard]] DirectoryTable select(std::span<const Row> rows) const;
+
+  [[nodiscard]] size_t memory_bytes() const;
+
+  // Raw columns, for writing the table out as is
+  [[nodiscard]] std::string_view name_arena() const { return names_; }
+  [[nodiscard]] std::span<const std::uint32_t> name_offsets() const {
+    return name_offsets_;
+  }
+  [[nodiscard]] std::span<const std::uint8_t> kinds() const { return kinds_; }
+  [[nodiscard]] std::span<const std::uint64_t> sizes() const { return sizes_; }
+  [[nodiscard]] std::span<const std::int64_t> mtimes() const {
+    return mtimes_;
+  }
+
+  // Rebuilds a table from raw columns, nullopt if they don't fit together.
+  // `sizes` and `mtimes` are either empty or one value per row.
+  static std::optional<DirectoryTable>
+  from_columns(std::string names, std::vector<std::uint32_t> name_offsets,
+               std::vector<std::uint8_t> kinds,
+               std::vector<std::uint64_t> sizes,
+               std::vector<std::int64_t> mtimes);
+};
+
+inline std::string_view EntryView::name() const { return table_->name(row_); }
+
+inline fs::file_type EntryView::type() const { return table_->type(row_); }
+
+inline bool EntryView::is_directory() const {
+  return table_->is_directory(row_);
+}
+
+inline bool EntryView::is_symlink() const { return table_->is_symlink(row_); }
+
+inline bool EntryView::is_hidden() const { return table_->is_hidden(row_); }
+
+inline bool EntryView::exists() const {
+  auto entry_type = type();
+  return entry_type != fs::file_type::none &&
+         entry_type != fs::file_type::not_found;
+}
+
+} // namespace duck
@@ -3,7 +3,9 @@
 #include "event_bus.hpp"
 #include "file_manager.hpp"
 #include "input_handler.hpp"
+#include "prefetcher.hpp"
 #include "ui.hpp"
+#include "watcher.hpp"
 
 namespace duck {
 class Duck {
@@ -13,6 +15,8 @@ private:
   Ui ui_;
   AppState state_;
   FileManager file_manager_;
+  Watcher watcher_;
+  Prefetcher prefetcher_;
   App app_;
 
 public:
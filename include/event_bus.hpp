@@ -1,6 +1,7 @@
 #pragma once
 #include "app_event.hpp"
 #include <condition_variable>
+#include <functional>
 #include <mutex>
 #include <optional>
 #include <queue>
@@ -32,6 +33,10 @@ public:
 
   std::optional<AppEvent> try_pop_event();
 
+  // Pops the front event only if `pred` accepts it, without waiting
+  std::optional<AppEvent>
+  try_pop_event_if(const std::function<bool(const AppEvent &)> &pred);
+
   bool empty() const;
 
   size_t size() const;
@@ -1,26 +1,115 @@
 #pragma once
+#include "app_event.hpp"
 #include "event_bus.hpp"
 #include "exec/async_scope.hpp"
+#include "image_preview.hpp"
+#include "sniffer.hpp"
 #include "utils.hpp"
+#include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexec/stop_token.hpp>
+#include <utility>
 #include <vector>
 
 namespace duck {
 
 namespace fs = std::filesystem;
 
+constexpr size_t preview_cache_size = 256;
+
+// Text previews are cut to the pane, so its size is part of the key. Hex
+// dumps start at `offset_`.
+struct PreviewKey {
+  FileIdentity identity_;
+  std::pair<int, int> size_;
+  std::uint64_t offset_ = 0;
+
+  bool operator==(const PreviewKey &) const = default;
+};
+
+struct PreviewKeyHash {
+  size_t operator()(const PreviewKey &key) const noexcept {
+    auto hash = std::hash<FileIdentity>{}(key.identity_);
+    auto size = (static_cast<std::uint64_t>(key.size_.first) << 32U) |
+                static_cast<std::uint32_t>(key.size_.second);
+    hash ^= size + 0x9E3779B97F4A7C15ULL + (hash << 6U) + (hash >> 2U);
+    return hash ^
+           (key.offset_ + 0x9E3779B97F4A7C15ULL + (hash << 6U) + (hash >> 2U));
+  }
+};
+
 class FileManager {
 private:
   EventBus &event_bus_;
   exec::async_scope scope_;
-  [[nodiscard]] std::string get_mime(const std::filesystem::path &path);
+  SortMode sort_mode_ = SortMode::Name;
+  ContentSniffer sniffer_;
+  ShardedLru<PreviewKey, EntryPreview, PreviewKeyHash> previews_{
+      preview_cache_size};
+  // Owned by the event thread. Shared with the outstanding preview task,
+  // which checks it before each step of I/O.
+  std::shared_ptr<stdexec::inplace_stop_source> preview_stop_;
+  Epoch preview_epoch_ = 0;
+  // Likewise for the directory being entered
+  std::shared_ptr<stdexec::inplace_stop_source> enter_stop_;
+  Epoch enter_epoch_ = 0;
+
+  // Preview of a file other than a directory, nullopt if it can't be read
+  // or the request was stopped
+  std::optional<EntryPreview>
+  file_preview(const fs::path &path, ContentType type,
+               const std::pair<int, int> &size, std::uint64_t offset,
+               const stdexec::inplace_stop_token &token);
+  // Highlights a text preview on the CPU pool and caches the result, which
+  // replaces the plain text already shown
+  void async_highlight(TextLinesPtr lines, Language language,
+                       std::optional<PreviewKey> key, Epoch epoch,
+                       std::shared_ptr<stdexec::inplace_stop_source> stop);
+  // Decodes an image on the CPU pool, shrunk to the pane, and caches it.
+  // The label pushed before it stays if the image can't be decoded.
+  void async_decode_image(const fs::path &path, ContentType type,
+                          const std::pair<int, int> &size,
+                          std::optional<PreviewKey> key, Epoch epoch,
+                          std::shared_ptr<stdexec::inplace_stop_source> stop);
 
 public:
-  static Directory load_directory(const fs::path &path);
+  static Directory load_directory(const fs::path &path,
+                                  SortMode mode = SortMode::Name);
+  // Gives up with nullopt once `cancelled` returns true, the listing grows
+  // past `max_entries` or the directory can't be read.
+  static std::optional<Directory>
+  load_directory_bounded(const fs::path &path, SortMode mode,
+                         size_t max_entries,
+                         const std::function<bool()> &cancelled);
+  static void load_metadata(Directory &directory);
+  void set_sort_mode(SortMode mode);
+  void async_sort_directory(Directory directory, SortMode mode);
   void async_load_directory(const fs::path &path);
+  // Reloads, in the background, every directory whose stamp changed
+  void async_revalidate(
+      std::vector<std::pair<fs::path, DirectoryStamp>> stamps);
+  // Streams the listing in chunks, then sends the sorted listing. Supersedes
+  // the previous call, whose task stops between batches without caching
+  // anything and whose chunks carry an older epoch.
   void async_enter_directory(const fs::path &path);
-  void async_update_preview(const fs::directory_entry &entry,
-                            const std::pair<int, int> &size);
+  void cancel_enter();
+  [[nodiscard]] Epoch enter_epoch() const;
+  // Supersedes the previous preview request, whose task stops before its
+  // next read and whose results are tagged with an older epoch. Hex dumps
+  // of binary files start at `offset`.
+  void async_update_preview(const Entry &entry,
+                            const std::pair<int, int> &size,
+                            std::uint64_t offset = 0);
+  void cancel_preview();
+  [[nodiscard]] Epoch preview_epoch() const;
+  // Preview of the file as it is now, if one was built for this size
+  // before. Only stats the file, so the event thread can call it.
+  std::optional<EntryPreview> cached_preview(const Entry &entry,
+                                             const std::pair<int, int> &size,
+                                             std::uint64_t offset = 0);
   void async_delete_entries(const std::vector<fs::path> &paths);
   void async_create_entry(const fs::path &path, bool is_directory);
   void async_rename_entry(const fs::path &old_path, const fs::path &new_path);
@@ -0,0 +1,38 @@
+#pragma once
+#include "preview_reader.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace duck {
+
+namespace fs = std::filesystem;
+
+// Bytes per row, fewer in a narrow pane
+constexpr size_t hex_row_bytes = 16;
+
+// Two lowercase hex digits per byte into `out`, sixteen bytes per step
+// with SSE2
+void encode_hex(std::span<const std::uint8_t> bytes, char *out);
+
+// Bytes per row that fit `columns`: 16, 8 or at least 4
+size_t hex_row_size(size_t columns);
+
+// xxd-style rows of `bytes`, which start at `offset` in the file:
+// offset, bytes in hex, then the bytes again as ASCII with '.' for
+// everything unprintable
+TextLines hex_lines(std::span<const std::uint8_t> bytes, std::uint64_t offset,
+                    size_t row_size);
+
+// Reads only the rows shown, starting at the row holding `offset` or the
+// last row of the file, whichever comes first. Nothing before it is read.
+std::optional<TextLines> read_hex(const fs::path &path, std::uint64_t offset,
+                                  size_t columns, size_t rows);
+
+// "0x1f0" or "496", nullopt for anything else
+std::optional<std::uint64_t> parse_offset(std::string_view text);
+
+} // namespace duck
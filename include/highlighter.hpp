@@ -0,0 +1,93 @@
+#pragma once
+#include "preview_reader.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace duck {
+
+namespace fs = std::filesystem;
+
+enum class Language : std::uint8_t {
+  Plain,
+  Cpp,
+  Python,
+  Json,
+  Yaml,
+  Shell,
+  Markdown,
+};
+
+enum class TokenKind : std::uint8_t {
+  Keyword,
+  String,
+  Number,
+  Comment,
+  Preprocessor,
+  Key,
+  Heading,
+  Code,
+};
+
+// Bytes [begin_, end_) of TextLines::text_. Bytes no token covers are
+// plain text.
+struct Token {
+  std::uint32_t begin_ = 0;
+  std::uint32_t end_ = 0;
+  TokenKind kind_ = TokenKind::Keyword;
+};
+
+// A text preview and its tokens in one array: the tokens of line i are
+// tokens_[token_offsets_[i], token_offsets_[i + 1]).
+struct HighlightedLines {
+  TextLinesPtr lines_;
+  std::vector<Token> tokens_;
+  std::vector<std::uint32_t> token_offsets_{0};
+
+  [[nodiscard]] std::span<const Token> line_tokens(size_t index) const {
+    auto begin = token_offsets_[index];
+    return std::span{tokens_}.subspan(begin,
+                                      token_offsets_[index + 1] - begin);
+  }
+};
+
+using HighlightedLinesPtr = std::shared_ptr<const HighlightedLines>;
+
+// By extension, or by the shebang for scripts without one
+Language detect_language(const fs::path &path, std::string_view first_line);
+
+// Tokenizes a line at a time. Block comments, multi-line strings and
+// fenced code carry over to the following lines.
+class Highlighter {
+public:
+  enum class State : std::uint8_t {
+    Normal,
+    BlockComment,
+    TripleSingle,
+    TripleDouble,
+    Fence,
+  };
+
+private:
+  Language language_;
+  State state_ = State::Normal;
+
+public:
+  explicit Highlighter(Language language) : language_{language} {}
+
+  // Appends the tokens of `line`, which starts at `base` in the text
+  void highlight_line(std::string_view line, std::uint32_t base,
+                      std::vector<Token> &tokens);
+};
+
+// Tokenizes every line of `lines`, giving up when `stopped` returns true
+std::optional<HighlightedLines>
+highlight(TextLinesPtr lines, Language language,
+          const std::function<bool()> &stopped);
+
+} // namespace duck
@@ -0,0 +1,64 @@
+#pragma once
+#include "sniffer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace duck {
+
+namespace fs = std::filesystem;
+
+// Larger images are not decoded. Also keeps the per channel sums of the
+// resize within 32 bits.
+constexpr size_t image_pixel_limit = size_t{1} << 24U;
+// Files of formats decoded from memory are read whole, up to this size
+constexpr size_t image_file_limit = size_t{64} << 20U;
+
+// RGBA, four bytes per pixel, rows top to bottom
+struct Image {
+  std::uint32_t width_ = 0;
+  std::uint32_t height_ = 0;
+  std::vector<std::uint8_t> pixels_;
+
+  [[nodiscard]] const std::uint8_t *pixel(std::uint32_t x,
+                                          std::uint32_t y) const {
+    return pixels_.data() + ((size_t{y} * width_) + x) * 4;
+  }
+};
+
+using ImagePtr = std::shared_ptr<const Image>;
+
+// Whether the image previews know how to decode `type`
+bool is_image(ContentType type);
+
+// Largest size with the aspect ratio of `width` x `height` that fits the
+// box, never larger than the image itself and at least one pixel
+std::pair<std::uint32_t, std::uint32_t>
+fit_size(std::uint32_t width, std::uint32_t height, std::uint32_t box_width,
+         std::uint32_t box_height);
+
+// First frame of a GIF, transparent where it doesn't cover the canvas
+std::optional<Image> decode_gif(std::span<const std::uint8_t> bytes);
+// Binary graymaps and pixmaps, P5 and P6, 8 or 16 bits per sample
+std::optional<Image> decode_netpbm(std::span<const std::uint8_t> bytes);
+
+// Box filter: each pixel of the result is the mean of the pixels of
+// `image` it covers. Only shrinks. Rows are filtered in parallel.
+Image resize_image(const Image &image, std::uint32_t width,
+                   std::uint32_t height);
+
+// Decodes `path` and shrinks it to fit a box of `box_width` x `box_height`
+// pixels. JPEGs are scaled while decoding. Nullopt if the file is broken,
+// too large, or `stopped` returns true between the steps.
+std::optional<Image> decode_image(const fs::path &path, ContentType type,
+                                  std::uint32_t box_width,
+                                  std::uint32_t box_height,
+                                  const std::function<bool()> &stopped);
+
+} // namespace duck
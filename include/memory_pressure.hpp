@@ -0,0 +1,11 @@
+#pragma once
+#include <optional>
+
+namespace duck {
+
+// "some avg10" of /proc/pressure/memory: the percentage of the last ten
+// seconds in which at least one task stalled waiting for memory. nullopt on
+// kernels without PSI.
+std::optional<double> memory_pressure();
+
+} // namespace duck
@@ -0,0 +1,67 @@
+#pragma once
+#include "event_bus.hpp"
+#include "exec/async_scope.hpp"
+#include "utils.hpp"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <unordered_set>
+#include <vector>
+
+namespace duck {
+
+namespace fs = std::filesystem;
+
+// Directories on each side of the cursor worth loading ahead of time
+constexpr size_t prefetch_radius = 2;
+// Rows scanned on each side of the cursor while looking for them
+constexpr size_t prefetch_scan_rows = 32;
+// Loads queued at once, parent included
+constexpr size_t prefetch_budget = 2 * prefetch_radius + 1;
+// Larger listings are left for an explicit visit
+constexpr size_t prefetch_max_entries = 20'000;
+
+struct PrefetchStats {
+  size_t issued_ = 0;
+  size_t loaded_ = 0;
+  size_t cancelled_ = 0;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+};
+
+// Loads directories the user is likely to open next on the background pool
+// and hands them to the cache as prefetched DirecotryLoaded events. Every
+// call to prefetch() starts a new generation; queued loads from older
+// generations notice and give up.
+class Prefetcher {
+private:
+  EventBus &event_bus_;
+  exec::async_scope scope_;
+  std::atomic<std::uint64_t> generation_{0};
+  std::atomic<size_t> issued_{0};
+  std::atomic<size_t> loaded_{0};
+  std::atomic<size_t> cancelled_{0};
+
+  // Owned by the event thread
+  std::unordered_set<fs::path> unused_;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+
+public:
+  explicit Prefetcher(EventBus &event_bus);
+
+  // Cancels outstanding loads and queues `paths`, most wanted first, up to
+  // prefetch_budget of them.
+  void prefetch(const std::vector<fs::path> &paths, SortMode mode);
+  void cancel();
+
+  // Called when a prefetched listing made it into the cache
+  void record_loaded(const fs::path &path);
+  // Called whenever the user opens or previews a directory, `cached` telling
+  // whether it was already in the cache
+  void record_access(const fs::path &path, bool cached);
+
+  [[nodiscard]] PrefetchStats stats() const;
+};
+
+} // namespace duck
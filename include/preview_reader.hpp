@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace duck {
+
+namespace fs = std::filesystem;
+
+// Bytes of a file a preview looks at, however long its lines are
+constexpr size_t preview_window_size = 1 << 20;
+
+// Lines of a text preview in one buffer: line i spans
+// text_[offsets_[i], offsets_[i + 1]).
+struct TextLines {
+  std::string text_;
+  std::vector<std::uint32_t> offsets_{0};
+
+  [[nodiscard]] size_t size() const { return offsets_.size() - 1; }
+  [[nodiscard]] bool empty() const { return size() == 0; }
+  [[nodiscard]] std::string_view line(size_t index) const {
+    return std::string_view{text_}.substr(
+        offsets_[index], offsets_[index + 1] - offsets_[index]);
+  }
+};
+
+using TextLinesPtr = std::shared_ptr<const TextLines>;
+
+// Terminal columns taken by the code point, 0 for combining marks
+int display_width(char32_t code_point);
+
+// Splits `bytes` into at most `rows` lines. Lines wider than `columns` are
+// cut at a character boundary and end in "...". Only the bytes up to the
+// last line taken are looked at.
+TextLines split_lines(std::string_view bytes, size_t columns, size_t rows);
+
+// Reads at most preview_window_size bytes from the start of `path`, in
+// growing chunks until `rows` lines are in, and splits them. Bytes past the
+// chunk holding the last line shown are never read.
+std::optional<TextLines> read_preview(const fs::path &path, size_t columns,
+                                      size_t rows);
+
+} // namespace duck
@@ -11,6 +11,7 @@ private:
   static inline exec::static_thread_pool io_pool_{1};
   static inline exec::static_thread_pool cpu_pool_{1};
   static inline exec::static_thread_pool priority_pool_{1};
+  static inline exec::static_thread_pool background_pool_{1};
 
 public:
   static exec::static_thread_pool::scheduler io_scheduler();
@@ -18,6 +19,9 @@ public:
   static exec::static_thread_pool::scheduler cpu_scheduler();
 
   static stdexec::scheduler auto priority_scheduler();
+
+  // Speculative work that must never delay io_scheduler()
+  static exec::static_thread_pool::scheduler background_scheduler();
 };
 
 } // namespace duck
@@ -0,0 +1,44 @@
+#pragma once
+#include "utils.hpp"
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace duck {
+
+namespace fs = std::filesystem;
+
+constexpr size_t snapshot_max_directories = 20;
+// Rows across all directories, keeps the file and the read bounded
+constexpr size_t snapshot_max_rows = 1 << 20;
+
+struct SnapshotSession {
+  fs::path current_path_;
+  std::string focused_name_;
+  size_t index_ = 0;
+  bool show_hidden_ = false;
+  SortMode sort_mode_ = SortMode::Name;
+  std::vector<Entry> selected_;
+};
+
+// Directory listings and cursor state saved on exit, so the next launch can
+// render before touching the filesystem and revalidate afterwards.
+struct Snapshot {
+  SnapshotSession session_;
+  // Most recently used first
+  std::vector<DirectoryPtr> directories_;
+};
+
+// $XDG_CACHE_HOME/duck/snapshot, falling back to ~/.cache/duck/snapshot
+std::optional<fs::path> snapshot_path();
+
+// Replaces `file` atomically. Directories without a stamp can't be
+// revalidated and are left out, as is anything past the limits above.
+bool write_snapshot(const fs::path &file, const Snapshot &snapshot);
+
+// Maps `file` and copies the columns out of it. Returns nullopt for a
+// missing, foreign or damaged file.
+std::optional<Snapshot> read_snapshot(const fs::path &file);
+
+} // namespace duck
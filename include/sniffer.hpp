@@ -0,0 +1,62 @@
+#pragma once
+#include "utils.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+namespace duck {
+
+namespace fs = std::filesystem;
+
+// Bytes read from the start of a file, enough for tar's header magic
+constexpr size_t sniff_head_size = 4096;
+constexpr size_t sniffer_cache_size = 4096;
+
+enum class ContentType : std::uint8_t {
+  Unreadable,
+  Empty,
+  Text,
+  Binary,
+  Png,
+  Jpeg,
+  Gif,
+  Netpbm,
+  Pdf,
+  Zip,
+  Gzip,
+  Bzip2,
+  Xz,
+  Zstd,
+  SevenZip,
+  Tar,
+  Elf,
+  Mp4,
+  Ogg,
+  Flac,
+  Mp3,
+  Sqlite,
+};
+
+std::string_view content_mime(ContentType type);
+
+// ASCII or well-formed UTF-8 without control bytes other than whitespace,
+// backspace and escape. A sequence cut off by the end of `bytes` is
+// accepted, since `bytes` is usually only the head of a file.
+bool is_text(std::span<const unsigned char> bytes);
+
+// Magic numbers first, then the text scan
+ContentType sniff_bytes(std::span<const unsigned char> head);
+
+// Sniffs the head of files and remembers the result per FileIdentity, so a
+// file is read again only once it changed. Safe to share between threads.
+class ContentSniffer {
+private:
+  ShardedLru<FileIdentity, ContentType> cache_{sniffer_cache_size};
+
+public:
+  ContentType sniff(const fs::path &path);
+};
+
+} // namespace duck
@@ -12,6 +12,7 @@
 #include <functional>
 #include <stack>
 #include <string>
+#include <vector>
 
 namespace duck {
 
@@ -31,6 +32,7 @@ private:
   ftxui::Component notification_;
   std::string notification_content_;
   ftxui::Component rename_dialog_;
+  ftxui::Component jump_dialog_;
   std::string input_content_;
   int cursor_positon_;
 
@@ -41,7 +43,8 @@ private:
     DELETION,
     RENAME,
     CREATION,
-    NOTIFICATION
+    NOTIFICATION,
+    JUMP
   };
   int active_pane_;
 
@@ -55,6 +58,7 @@ public:
   void async_toggle_rename_dialog();
   void async_toggle_creation_dialog();
   void async_toggle_notification();
+  void async_toggle_jump_dialog();
 
   void async_update_info(MenuInfo new_info);
   void async_update_index(size_t index);
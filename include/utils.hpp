@@ -1,37 +1,261 @@
 #pragma once
+#include "directory_table.hpp"
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <limits>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace duck {
 
 namespace fs = std::filesystem;
 
+// A directory entry whose type was taken from the directory listing itself,
+// so that querying it never touches the filesystem.
+class Entry {
+private:
+  fs::path path_;
+  fs::file_type type_ = fs::file_type::none;
+  bool is_symlink_ = false;
+
+public:
+  Entry() = default;
+  Entry(fs::path path, fs::file_type type, bool is_symlink = false)
+      : path_{std::move(path)}, type_{type}, is_symlink_{is_symlink} {}
+
+  [[nodiscard]] const fs::path &path() const { return path_; }
+  [[nodiscard]] fs::file_type type() const { return type_; }
+  [[nodiscard]] bool is_directory() const {
+    return type_ == fs::file_type::directory;
+  }
+  [[nodiscard]] bool is_symlink() const { return is_symlink_; }
+  [[nodiscard]] bool exists() const {
+    return type_ != fs::file_type::none && type_ != fs::file_type::not_found;
+  }
+
+  bool operator==(const Entry &other) const { return path_ == other.path_; }
+  auto operator<=>(const Entry &other) const { return path_ <=> other.path_; }
+};
+
+// Identity and change times of a directory when its listing was read. Any
+// entry created, removed or renamed inside it bumps mtime.
+struct DirectoryStamp {
+  std::uint64_t inode_ = 0;
+  std::int64_t mtime_ = 0;
+  std::int64_t ctime_ = 0;
+
+  bool operator==(const DirectoryStamp &) const = default;
+};
+
+std::optional<DirectoryStamp> stamp_directory(const fs::path &path);
+
+// Identity and version of a file's contents, for caching anything derived
+// from them. Rewriting the file changes mtime or size.
+struct FileIdentity {
+  std::uint64_t device_ = 0;
+  std::uint64_t inode_ = 0;
+  std::int64_t mtime_ = 0;
+  std::uint64_t size_ = 0;
+
+  bool operator==(const FileIdentity &) const = default;
+};
+
+std::optional<FileIdentity> identify_file(int fd);
+// Follows symlinks, like opening the path would
+std::optional<FileIdentity> identify_path(const fs::path &path);
+
+// Removes and renames leave dead rows in the table; once they are more than
+// this fraction (1/n) of it, the table is rebuilt with live rows only
+constexpr size_t dead_row_share = 2;
+
+// A directory listing: every entry lives in table_, entries_ and
+// hidden_entries_ hold the rows of visible and hidden entries sorted by
+// sort_mode_, and all_entries_ both merged, so either view of the listing
+// is a plain array.
 struct Directory {
   fs::path path_;
-  std::vector<fs::directory_entry> entries_;
-  std::vector<fs::directory_entry> hidden_entries_;
+  DirectoryTable table_;
+  std::vector<Row> entries_;
+  std::vector<Row> hidden_entries_;
+  std::vector<Row> all_entries_;
+  SortMode sort_mode_ = SortMode::Name;
+  std::optional<DirectoryStamp> stamp_;
+  // Built from streamed chunks by a load still running or cancelled
+  bool partial_ = false;
+
+  [[nodiscard]] Entry entry(Row row) const;
+  [[nodiscard]] std::optional<Row> find(std::string_view name) const;
+  Row add_entry(std::string_view name, fs::file_type type,
+                bool is_symlink = false);
+  Row insert_entry(std::string_view name, fs::file_type type,
+                   bool is_symlink = false);
+  std::optional<Row> rename_entry(std::string_view old_name,
+                                  std::string_view new_name);
+  void remove_entry(std::string_view name);
+  // Drops dead rows if there are enough of them, renumbering the live ones.
+  // Whether rows moved.
+  bool compact();
+  // Drops every dead row, renumbering the live ones
+  void drop_dead_rows();
+  void set_metadata(Row row, std::uint64_t size_bytes, std::int64_t mtime_ns);
+  void merge(const DirectoryTable &chunk);
+  void sort();
+  void set_sort_mode(SortMode mode);
+  void merge_hidden();
+  [[nodiscard]] std::span<const Row> rows(bool show_hidden) const {
+    return show_hidden ? all_entries_ : entries_;
+  }
+  [[nodiscard]] size_t memory_bytes() const;
+  [[nodiscard]] bool less(Row first, Row second) const {
+    return table_.less(first, second, sort_mode_);
+  }
 };
 
-template <typename Key, typename Value> class Lru {
+// Cached listings are immutable once shared, changes go through a copy
+using DirectoryPtr = std::shared_ptr<const Directory>;
+
+enum class Eviction : std::uint8_t {
+  Lru,
+  // 2Q: new keys wait in a FIFO probation queue and only keys seen again
+  // after leaving it join the LRU list, so a one-off walk over many keys
+  // can't flush the ones in regular use
+  TwoQueue,
+};
+
+// Probation takes up to this fraction (1/n) of the capacity and budget
+constexpr size_t two_queue_probation_share = 4;
+// Evicted probation keys are remembered for this fraction of the capacity
+constexpr size_t two_queue_ghost_share = 2;
+
+// Least recently used cache bounded by entry count and, given a weight
+// function, by the total weight of its values.
+template <typename Key, typename Value, Eviction policy = Eviction::Lru>
+class Lru {
+public:
+  using Weigher = std::function<size_t(const Value &)>;
+
 private:
+  using Iterator = typename std::list<Key>::iterator;
+  struct Position {
+    Iterator iter_;
+    bool probation_ = false;
+  };
+
   size_t capacity_;
+  size_t budget_ = std::numeric_limits<size_t>::max();
+  size_t weight_ = 0;
+  Weigher weigher_;
   std::list<Key> lru_list_;
-  std::unordered_map<Key, typename std::list<Key>::iterator> map_;
+  // TwoQueue only: keys seen once, newest first, and recent evictions from
+  // there without their values
+  std::list<Key> probation_;
+  size_t probation_weight_ = 0;
+  std::list<Key> ghosts_;
+  std::unordered_map<Key, Iterator> ghost_map_;
+  std::unordered_map<Key, Position> map_;
   std::unordered_map<Key, Value> cache_;
+  std::unordered_map<Key, size_t> weights_;
+  // Passed over by eviction
+  std::vector<Key> pinned_;
   std::shared_mutex lru_mutex_;
   void touch_without_lock(const Key &path) {
-    lru_list_.splice(lru_list_.begin(), lru_list_, map_[path]);
+    // Repeats within probation are taken as one correlated burst
+    if (auto &position = map_[path]; !position.probation_) {
+      lru_list_.splice(lru_list_.begin(), lru_list_, position.iter_);
+    }
+  }
+
+  // Returns whether `path` was a ghost, forgetting it
+  bool forget_without_lock(const Key &path) {
+    auto iter = ghost_map_.find(path);
+    if (iter == ghost_map_.end()) {
+      return false;
+    }
+    ghosts_.erase(iter->second);
+    ghost_map_.erase(iter);
+    return true;
+  }
+
+  // Moves the key at the back of `list` to the front of the LRU list
+  void promote_without_lock(std::list<Key> &list) {
+    auto &position = map_[list.back()];
+    if (position.probation_) {
+      probation_weight_ -= weights_[list.back()];
+      position.probation_ = false;
+    }
+    lru_list_.splice(lru_list_.begin(), list, position.iter_);
+  }
+
+  void pop_back_without_lock(std::list<Key> &list) {
+    const auto &key = list.back();
+    auto weight = weights_[key];
+    weight_ -= weight;
+    if (&list == &probation_) {
+      probation_weight_ -= weight;
+      ghosts_.push_front(key);
+      ghost_map_[key] = ghosts_.begin();
+      if (ghosts_.size() > capacity_ / two_queue_ghost_share) {
+        ghost_map_.erase(ghosts_.back());
+        ghosts_.pop_back();
+      }
+    }
+    weights_.erase(key);
+    map_.erase(key);
+    cache_.erase(key);
+    list.pop_back();
+  }
+
+  // Evicts from the back down to `budget`, always keeping the most recent
+  // value of each list even if it alone is over budget. Pinned keys met on
+  // the way go to the front of the LRU list, until all of them have been
+  // passed over once more than there are pins.
+  void evict_without_lock(size_t budget) {
+    size_t skipped = 0;
+    while ((lru_list_.size() + probation_.size() > capacity_ ||
+            weight_ > budget) &&
+           skipped <= pinned_.size()) {
+      auto probation_full =
+          probation_.size() > capacity_ / two_queue_probation_share ||
+          probation_weight_ > budget / two_queue_probation_share;
+      auto *list = &lru_list_;
+      if (probation_.size() > 1 &&
+          (probation_full || lru_list_.size() <= 1)) {
+        list = &probation_;
+      } else if (lru_list_.size() <= 1) {
+        break;
+      }
+      if (std::ranges::find(pinned_, list->back()) != pinned_.end()) {
+        promote_without_lock(*list);
+        ++skipped;
+      } else {
+        pop_back_without_lock(*list);
+      }
+    }
   }
 
 public:
   Lru(size_t capacity) : capacity_{capacity} {}
+  Lru(size_t capacity, size_t budget, Weigher weigher)
+      : capacity_{capacity}, budget_{budget}, weigher_{std::move(weigher)} {}
 
+  // Reordering the list needs the exclusive lock, so reads serialize. See
+  // ShardedLru for lookups from several threads.
   std::optional<Value> get(const Key &path) {
     std::unique_lock lock{lru_mutex_};
     auto iter = map_.find(path);
@@ -44,71 +268,268 @@ public:
     return cache_[path];
   }
 
+  // Calls `fn` on the cached value in place, without copying it or touching
+  // the recency order
+  template <typename Fn>
+  auto peek(const Key &path, Fn &&fn)
+      -> std::optional<std::invoke_result_t<Fn, const Value &>> {
+    std::shared_lock lock{lru_mutex_};
+    auto iter = cache_.find(path);
+    if (iter == cache_.end()) {
+      return std::nullopt;
+    }
+    return fn(iter->second);
+  }
+
+  // Lookup that leaves the recency order alone
+  bool contains(const Key &path) {
+    std::shared_lock lock{lru_mutex_};
+    return map_.contains(path);
+  }
+
+  // Keys from most to least recently used, those still on probation last
+  std::vector<Key> keys() {
+    std::shared_lock lock{lru_mutex_};
+    std::vector<Key> keys{lru_list_.begin(), lru_list_.end()};
+    keys.insert(keys.end(), probation_.begin(), probation_.end());
+    return keys;
+  }
+
+  // Total weight of the cached values, their count without a weight function
+  size_t weight() {
+    std::shared_lock lock{lru_mutex_};
+    return weight_;
+  }
+
+  size_t budget() {
+    std::shared_lock lock{lru_mutex_};
+    return budget_;
+  }
+
+  void set_budget(size_t budget) {
+    std::unique_lock lock{lru_mutex_};
+    budget_ = budget;
+    evict_without_lock(budget_);
+  }
+
+  // Replaces the keys kept out of eviction, cached yet or not
+  void pin(std::vector<Key> keys) {
+    std::unique_lock lock{lru_mutex_};
+    pinned_ = std::move(keys);
+  }
+
+  // One-off eviction down to `weight`, the budget itself stays
+  void shrink_to(size_t weight) {
+    std::unique_lock lock{lru_mutex_};
+    evict_without_lock(weight);
+  }
+
   void insert(Key path, Value data) {
-    auto iter = map_.find(path);
+    auto weight = weigher_ ? weigher_(data) : 1;
     std::unique_lock lock{lru_mutex_};
-    if (iter != map_.end()) {
-      cache_[path] = std::move(data);
+    if (auto iter = map_.find(path); iter != map_.end()) {
+      weight_ -= weights_[path];
+      if (iter->second.probation_) {
+        probation_weight_ -= weights_[path];
+      }
       touch_without_lock(path);
+    } else if (policy == Eviction::Lru || forget_without_lock(path)) {
+      lru_list_.push_front(path);
+      map_[path] = {.iter_ = lru_list_.begin()};
     } else {
-      if (lru_list_.size() == capacity_) {
-        const auto &lru_key = lru_list_.back();
+      probation_.push_front(path);
+      map_[path] = {.iter_ = probation_.begin(), .probation_ = true};
+    }
+    if (map_[path].probation_) {
+      probation_weight_ += weight;
+    }
+    cache_[path] = std::move(data);
+    weights_[path] = weight;
+    weight_ += weight;
+    evict_without_lock(budget_);
+  }
+};
 
-        map_.erase(lru_key);
-        cache_.erase(lru_key);
+constexpr size_t cache_line_size = 64;
+constexpr size_t sharded_lru_shards = 16;
 
-        lru_list_.pop_back();
-      }
+// Count-bounded cache for lookups from many threads. Keys are spread over
+// independently locked shards, and reads only take a shard's shared lock:
+// instead of reordering a list they set the slot's reference bit, and
+// eviction runs CLOCK over the shard, giving referenced slots a second
+// chance. Recency is therefore approximate and per shard.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class ShardedLru {
+private:
+  struct Slot {
+    Key key_;
+    Value value_;
+    std::atomic<bool> referenced_{false};
+  };
 
-      lru_list_.push_front(path);
-      map_[path] = lru_list_.begin();
-      cache_[path] = std::move(data);
+  struct alignas(cache_line_size) Shard {
+    std::shared_mutex mutex_;
+    // Slots never move, so the index can refer to them by position
+    std::deque<Slot> slots_;
+    std::unordered_map<Key, size_t, Hash> index_;
+    size_t hand_ = 0;
+  };
+
+  size_t shard_bits_;
+  size_t shard_capacity_;
+  std::vector<Shard> shards_;
+
+  Shard &shard_for(const Key &key) {
+    if (shard_bits_ == 0) {
+      return shards_.front();
     }
+    // Fibonacci hashing, so weak hashes still spread over the shards
+    auto hash =
+        static_cast<std::uint64_t>(Hash{}(key)) * 0x9E3779B97F4A7C15ULL;
+    return shards_[hash >> (64 - shard_bits_)];
   }
-};
 
-inline std::string entry_icon(const fs::directory_entry &entry) {
-  if (entry.path().empty()) {
-    return "[Invalid Entry]";
+  static void reference(Slot &slot) {
+    // Skip the store when already set to keep the cache line shared
+    if (!slot.referenced_.load(std::memory_order_relaxed)) {
+      slot.referenced_.store(true, std::memory_order_relaxed);
+    }
   }
 
-  static const std::unordered_map<std::string, std::string> extension_icons{
-      {".txt", "\uf15c"}, {".md", "\ueeab"},   {".cpp", "\ue61d"},
-      {".hpp", "\uf0fd"}, {".h", "\uf0fd"},    {".c", "\ue61e"},
-      {".jpg", "\uf4e5"}, {".jpeg", "\uf4e5"}, {".png", "\uf4e5"},
-      {".gif", "\ue60d"}, {".pdf", "\ue67d"},  {".zip", "\ue6aa"},
-      {".mp3", "\uf001"}, {".mp4", "\uf03d"},  {".json", "\ue60b"},
-      {".log", "\uf4ed"}, {".csv", "\ueefc"},
-  };
+public:
+  // `shards` is rounded up to a power of two, the capacity is split evenly
+  explicit ShardedLru(size_t capacity, size_t shards = sharded_lru_shards)
+      : shard_bits_{static_cast<size_t>(
+            std::countr_zero(std::bit_ceil(std::max<size_t>(shards, 1))))},
+        shard_capacity_{std::max<size_t>(
+            1, (capacity + (size_t{1} << shard_bits_) - 1) >> shard_bits_)},
+        shards_(size_t{1} << shard_bits_) {}
 
-  if (!fs::exists(entry) || entry.path().empty()) {
-    return {""};
+  std::optional<Value> get(const Key &key) {
+    auto &shard = shard_for(key);
+    std::shared_lock lock{shard.mutex_};
+    auto iter = shard.index_.find(key);
+    if (iter == shard.index_.end()) {
+      return std::nullopt;
+    }
+    auto &slot = shard.slots_[iter->second];
+    reference(slot);
+    return slot.value_;
+  }
+
+  // Calls `fn` on the cached value in place, leaving the reference bit alone
+  template <typename Fn>
+  auto peek(const Key &key, Fn &&fn)
+      -> std::optional<std::invoke_result_t<Fn, const Value &>> {
+    auto &shard = shard_for(key);
+    std::shared_lock lock{shard.mutex_};
+    auto iter = shard.index_.find(key);
+    if (iter == shard.index_.end()) {
+      return std::nullopt;
+    }
+    return fn(std::as_const(shard.slots_[iter->second].value_));
+  }
+
+  bool contains(const Key &key) {
+    auto &shard = shard_for(key);
+    std::shared_lock lock{shard.mutex_};
+    return shard.index_.contains(key);
+  }
+
+  void insert(Key key, Value value) {
+    auto &shard = shard_for(key);
+    std::unique_lock lock{shard.mutex_};
+    if (auto iter = shard.index_.find(key); iter != shard.index_.end()) {
+      auto &slot = shard.slots_[iter->second];
+      slot.value_ = std::move(value);
+      reference(slot);
+      return;
+    }
+
+    auto &slots = shard.slots_;
+    if (slots.size() < shard_capacity_) {
+      shard.index_.emplace(key, slots.size());
+      slots.emplace_back(std::move(key), std::move(value));
+      return;
+    }
+
+    while (slots[shard.hand_].referenced_.exchange(
+        false, std::memory_order_relaxed)) {
+      shard.hand_ = (shard.hand_ + 1) % slots.size();
+    }
+    auto &victim = slots[shard.hand_];
+    shard.index_.erase(victim.key_);
+    shard.index_.emplace(key, shard.hand_);
+    victim.key_ = std::move(key);
+    victim.value_ = std::move(value);
+    shard.hand_ = (shard.hand_ + 1) % slots.size();
+  }
+
+  size_t size() {
+    size_t count = 0;
+    for (auto &shard : shards_) {
+      std::shared_lock lock{shard.mutex_};
+      count += shard.index_.size();
+    }
+    return count;
   }
 
-  if (fs::is_directory(entry)) {
-    return {"\uf4d3"};
+  [[nodiscard]] size_t capacity() const {
+    return shard_capacity_ * shards_.size();
+  }
+};
+
+inline std::string sort_mode_name(SortMode mode) {
+  switch (mode) {
+  case SortMode::Name:
+    return "name";
+  case SortMode::Size:
+    return "size";
+  case SortMode::Mtime:
+    return "mtime";
+  case SortMode::Extension:
+    return "extension";
+  case SortMode::Natural:
+    return "natural";
   }
+  return "";
+}
 
-  auto ext = entry.path().extension().string();
-  std::ranges::transform(ext, ext.begin(), [](char character) {
-    return static_cast<char>(std::tolower(character));
-  });
+// Indexed by FileClass
+constexpr std::array<std::string_view, file_class_count> file_icons{
+    "",        "\uf4d3", "\uf15c", "\uf15c", "\ueeab", "\ue61d",
+    "\uf0fd", "\ue61e", "\uf4e5", "\ue60d", "\ue67d", "\ue6aa",
+    "\uf001", "\uf03d", "\ue60b", "\uf4ed", "\ueefc",
+};
 
-  auto icon_it = extension_icons.find(ext);
-  const std::string &icon =
-      icon_it != extension_icons.end() ? icon_it->second : "\uf15c";
+constexpr std::string_view file_icon(FileClass file_class) {
+  return file_icons[static_cast<size_t>(file_class)];
+}
 
-  return icon;
+inline std::string_view entry_icon(const Entry &entry) {
+  return file_icon(
+      classify(entry.path().filename().native(), entry.type()));
 }
 
-inline bool entries_sorter(const fs::directory_entry &first,
-                           const fs::directory_entry &second) {
+inline bool entries_sorter(const EntryView &first, const EntryView &second) {
   if (first.is_directory() != second.is_directory()) {
     return static_cast<int>(first.is_directory()) >
            static_cast<int>(second.is_directory());
   }
 
-  return first.path().filename() < second.path().filename();
+  return first.name() < second.name();
 }
 
 } // namespace duck
+
+template <> struct std::hash<duck::FileIdentity> {
+  size_t operator()(const duck::FileIdentity &identity) const noexcept {
+    auto hash = identity.inode_;
+    for (auto value : {identity.device_,
+                       static_cast<std::uint64_t>(identity.mtime_),
+                       identity.size_}) {
+      hash ^= value + 0x9E3779B97F4A7C15ULL + (hash << 6U) + (hash >> 2U);
+    }
+    return hash;
+  }
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include "app_event.hpp"
+#include "event_bus.hpp"
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace duck {
+
+namespace fs = std::filesystem;
+
+constexpr size_t max_watched_directories = 16;
+constexpr auto watcher_debounce = std::chrono::milliseconds{30};
+constexpr auto watcher_max_latency = std::chrono::milliseconds{200};
+
+// Watches directories with inotify and pushes their changes as
+// DirectoryChanged events. Bursts are debounced so that a tool creating
+// thousands of files produces a handful of batches instead of a reload per
+// file.
+class Watcher {
+private:
+  EventBus &event_bus_;
+  int fd_ = -1;
+  std::mutex mutex_;
+  std::unordered_map<int, fs::path> paths_;
+  std::unordered_map<fs::path, int> descriptors_;
+  std::jthread watcher_thread_;
+
+  void run(const std::stop_token &stop);
+  std::optional<fs::path> watched_path(int descriptor);
+
+public:
+  explicit Watcher(EventBus &event_bus);
+  ~Watcher();
+
+  Watcher(const Watcher &) = delete;
+  Watcher &operator=(const Watcher &) = delete;
+  Watcher(Watcher &&) = delete;
+  Watcher &operator=(Watcher &&) = delete;
+
+  // Replaces the watched set with `paths`, keeping watches that are still
+  // wanted and dropping the rest.
+  void watch(const std::vector<fs::path> &paths);
+  std::vector<fs::path> watched();
+};
+
+} // namespace duck
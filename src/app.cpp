@@ -1,8 +1,12 @@
 #include "app.hpp"
 #include "app_event.hpp"
 #include "file_manager.hpp"
+#include "hex_dump.hpp"
+#include "snapshot.hpp"
 #include "ftxui/dom/elements.hpp"
 #include "utils.hpp"
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <ftxui/component/component.hpp>
@@ -10,23 +14,103 @@
 #include <ftxui/screen/terminal.hpp>
 #include <optional>
 #include <print>
+#include <ranges>
 #include <stdexec/execution.hpp>
 #include <string>
 #include <wait.h>
 
 namespace fs = std::filesystem;
 namespace duck {
-App::App(EventBus &event_bus, Ui &ui, FileManager &file_manager)
-    : event_bus_{event_bus}, ui_{ui}, file_manager_{file_manager} {}
+App::App(EventBus &event_bus, Ui &ui, FileManager &file_manager,
+         Watcher &watcher, Prefetcher &prefetcher)
+    : event_bus_{event_bus}, ui_{ui}, file_manager_{file_manager},
+      watcher_{watcher}, prefetcher_{prefetcher} {
+  if (const auto *trace = std::getenv("DUCK_TRACE")) {
+    trace_.open(trace, std::ios::app);
+  }
+}
 
 void App::run() {
   running_ = true;
   event_processing_thread_ = std::jthread([this] { process_events(); });
+  auto started = std::chrono::steady_clock::now();
   state_.current_path_ = fs::current_path();
-  state_.current_directory_ = FileManager::load_directory(state_.current_path_);
-  state_.cache_.insert(state_.current_path_, state_.current_directory_);
+  restore_snapshot();
+  if (!state_.cache_.contains(state_.current_path_)) {
+    state_.cache_directory(
+        FileManager::load_directory(state_.current_path_, state_.sort_mode_));
+  }
+  state_.current_directory_ = state_.cache_.get(state_.current_path_).value();
+  state_.pin_current();
+  startup_time_ = std::chrono::steady_clock::now() - started;
+  update_watches();
   update_preview();
+  schedule_prefetch();
   ui_.run(state_);
+  save_snapshot();
+}
+
+std::chrono::steady_clock::duration App::startup_time() const {
+  return startup_time_;
+}
+
+bool App::restored_from_snapshot() const { return restored_from_snapshot_; }
+
+// Serves the saved listings right away and leaves checking them against the
+// filesystem to the background.
+void App::restore_snapshot() {
+  auto path = snapshot_path();
+  auto snapshot = path ? read_snapshot(path.value()) : std::nullopt;
+  if (!snapshot) {
+    return;
+  }
+
+  std::vector<std::pair<fs::path, DirectoryStamp>> stamps;
+  for (auto &directory : snapshot->directories_ | std::views::reverse) {
+    stamps.emplace_back(directory->path_, directory->stamp_.value());
+    state_.cache_.insert(directory->path_, std::move(directory));
+  }
+  restored_from_snapshot_ = state_.cache_.contains(state_.current_path_);
+
+  const auto &session = snapshot->session_;
+  state_.show_hidden_ = session.show_hidden_;
+  state_.sort_mode_ = session.sort_mode_;
+  file_manager_.set_sort_mode(session.sort_mode_);
+  state_.selected_entries_ = {session.selected_.begin(),
+                              session.selected_.end()};
+  if (session.current_path_ == state_.current_path_ &&
+      !state_.focus_entry(state_.current_path_ / session.focused_name_)) {
+    auto size = state_.entries_size(state_.current_path_);
+    state_.index_ = size == 0 ? 0 : std::min(session.index_, size - 1);
+  }
+
+  file_manager_.async_revalidate(std::move(stamps));
+}
+
+void App::save_snapshot() {
+  auto path = snapshot_path();
+  if (!path) {
+    return;
+  }
+
+  Snapshot snapshot;
+  auto &session = snapshot.session_;
+  session.current_path_ = state_.current_path_;
+  session.index_ = state_.index_;
+  if (auto entry = state_.indexed_entry()) {
+    session.focused_name_ = entry.value().path().filename().native();
+  }
+  session.show_hidden_ = state_.show_hidden_;
+  session.sort_mode_ = state_.sort_mode_;
+  session.selected_ = {state_.selected_entries_.begin(),
+                       state_.selected_entries_.end()};
+  for (const auto &key : state_.cache_.keys()) {
+    if (auto directory = state_.cache_.get(key);
+        directory && !directory.value()->partial_) {
+      snapshot.directories_.push_back(std::move(directory.value()));
+    }
+  }
+  write_snapshot(path.value(), snapshot);
 }
 
 void App::stop() {
@@ -38,7 +122,12 @@ void App::stop() {
 
 void App::process_events() {
   while (running_) {
-    auto event_opt = event_bus_.pop_event();
+    auto event_opt =
+        preview_due_
+            ? event_bus_.pop_event_with_timeout(
+                  std::chrono::ceil<std::chrono::milliseconds>(
+                      preview_due_.value() - std::chrono::steady_clock::now()))
+            : event_bus_.pop_event();
     if (event_opt) {
       auto event = event_opt.value();
       std::visit(
@@ -48,29 +137,117 @@ void App::process_events() {
               [this](const DirecotryLoaded &event) {
                 handle_directory_loaded(event);
               },
+              [this](const DirectoryChunk &event) {
+                handle_directory_chunk(event);
+              },
+              [this](const DirectoryChanged &event) {
+                handle_directory_changed(event);
+              },
               [this](const TextPreview &event) {
                 handle_preview_updated(event);
               },
           },
           event);
     }
+    // Checked after every event, not only on a timeout: a steady stream of
+    // chunks or watcher batches would otherwise hold the preview back. After
+    // the event, so a cursor move in it pushes the deadline first.
+    if (preview_due_ &&
+        std::chrono::steady_clock::now() >= preview_due_.value()) {
+      settle_cursor();
+    }
   }
 }
 
 void App::handle_directory_loaded(const DirecotryLoaded &event) {
-  state_.cache_.insert(event.directory_.path_, event.directory_);
-  if (event.update_preview_) {
+  if (event.prefetched_) {
+    const auto &path = event.directory_.path_;
+    if (state_.cache_.contains(path)) {
+      return;
+    }
+    state_.cache_directory(event.directory_);
+    prefetcher_.record_loaded(path);
+    // The preview may still be waiting on its own load of this directory
+    if (auto entry = state_.indexed_entry(); entry && entry->path() == path) {
+      update_preview();
+    }
+    return;
+  }
+
+  if (event.keep_focus_) {
+    if (streaming_ == event.directory_.path_) {
+      streaming_.reset();
+    }
+    state_.commit_directory(event.directory_);
+    // Every chunk was dropped on the way, or there were too few entries to
+    // stream
+    if (entering_ == event.directory_.path_ &&
+        event.epoch_ == file_manager_.enter_epoch()) {
+      entering_.reset();
+      update_current_direcotry(event.directory_.path_);
+    } else if (event.directory_.path_ == state_.current_path_) {
+      refresh_menu();
+    }
+    return;
+  }
+
+  state_.cache_directory(event.directory_);
+  if (event.update_preview_ &&
+      event.epoch_ == file_manager_.preview_epoch()) {
+    update_preview();
+  }
+}
+
+void App::handle_directory_chunk(const DirectoryChunk &event) {
+  // Streamed by a load the user navigated away from
+  if (event.epoch_ != file_manager_.enter_epoch()) {
+    return;
+  }
+  if (entering_ == event.path_) {
+    entering_.reset();
+    streaming_ = event.path_;
+    state_.cache_directory(Directory{.path_ = event.path_, .partial_ = true});
+    state_.merge_entries(event.path_, event.table_);
+    update_current_direcotry(event.path_);
+    return;
+  }
+
+  state_.merge_entries(event.path_, event.table_);
+  if (event.path_ == state_.current_path_) {
+    refresh_menu();
+  }
+}
+
+void App::handle_directory_changed(const DirectoryChanged &event) {
+  if (event.overflow_) {
+    file_manager_.async_load_directory(event.path_);
+    return;
+  }
+
+  auto focused = state_.indexed_entry();
+  state_.apply_changes(event.path_, event.changes_, event.stamp_);
+  if (event.path_ == state_.current_path_) {
+    refresh_menu();
+    if (state_.indexed_entry() != focused) {
+      update_preview();
+    }
+  } else if (focused && focused.value().path() == event.path_) {
     update_preview();
   }
 }
 
 void App::handle_preview_updated(const TextPreview &event) {
+  // Late result for an entry the cursor already left
+  if (event.epoch_ != file_manager_.preview_epoch()) {
+    return;
+  }
   ui_.async_update_preview(event.preview_);
 }
 
 void App::handle_fmgr_event(const FmgrEvent &event) {
   switch (event.type_) {
   case FmgrEvent::Type::UpdateCurrentDirectory: {
+    cancel_entering();
     update_current_direcotry(event.path);
     break;
   }
@@ -93,13 +270,16 @@ void App::handle_fmgr_event(const FmgrEvent &event) {
   case FmgrEvent::Type::Rename:
     confirm_rename();
     break;
+  case FmgrEvent::Type::JumpToOffset:
+    confirm_jump();
+    break;
   case FmgrEvent::Type::RenameSuccess: {
     state_.rename_entry(event.path, event.path_to);
     refresh_menu();
     break;
   }
   case FmgrEvent::Type::CreationSuccess: {
-    state_.create_entry(event.path);
+    state_.create_entry(event.path, event.is_directory);
     refresh_menu();
     break;
   }
@@ -115,19 +295,19 @@ void App::handle_fmgr_event(const FmgrEvent &event) {
     paste_selected_entries();
     break;
   }
+  case FmgrEvent::Type::CycleSortMode: {
+    cycle_sort_mode();
+    break;
+  }
   }
 }
 
 void App::handle_render_event(const RenderEvent &event) {
   switch (event.type_) {
-  case RenderEvent::Type::MoveIndexDown: {
-    move_index_down();
-    break;
-  }
-  case RenderEvent::Type::MoveIndexUp: {
-    move_index_up();
+  case RenderEvent::Type::MoveIndexDown:
+  case RenderEvent::Type::MoveIndexUp:
+    move_index(navigation_delta(event));
     break;
-  }
   case RenderEvent::Type::EnterDirectory:
     enter_directory();
     break;
@@ -146,6 +326,9 @@ void App::handle_render_event(const RenderEvent &event) {
   case RenderEvent::Type::ToggleNotification:
     toggle_notification();
     break;
+  case RenderEvent::Type::ToggleJumpDialog:
+    toggle_jump_dialog();
+    break;
   case RenderEvent::Type::ClearMarks:
     clear_marks();
     break;
@@ -157,29 +340,125 @@ void App::handle_render_event(const RenderEvent &event) {
 }
 
 void App::update_current_direcotry(const fs::path &path) {
+  revalidate(path);
   auto directory = state_.cache_.get(path).value();
   state_.current_directory_ = directory;
-  state_.current_path_ = directory.path_;
+  state_.current_path_ = directory->path_;
+  state_.pin_current();
   state_.index_ = 0;
   refresh_menu();
   update_preview();
+  update_watches();
+  schedule_prefetch();
 }
 
-void App::move_index_down() {
-  state_.move_index_down();
-  ui_.async_update_index(state_.index_);
-  update_preview();
+// Keeps serving the cached listing and swaps in a fresh one when it arrives
+void App::revalidate(const fs::path &path) {
+  if (streaming_ != path && state_.is_stale(path)) {
+    file_manager_.async_load_directory(path);
+  }
+}
+
+RevalidationStats App::revalidation_stats() const {
+  return state_.revalidation_stats_;
+}
+
+CacheStats App::cache_stats() { return state_.cache_stats(); }
+
+void App::record_access(const fs::path &path, bool cached) {
+  prefetcher_.record_access(path, cached);
+  if (trace_.is_open()) {
+    trace_ << path.native() << '\n';
+  }
 }
 
-void App::move_index_up() {
-  state_.move_index_up();
+void App::update_watches() {
+  std::vector<fs::path> paths{state_.current_path_};
+  if (state_.current_path_ != state_.current_path_.root_path()) {
+    paths.push_back(state_.current_path_.parent_path());
+  }
+  for (auto &path : state_.cache_.keys()) {
+    if (paths.size() >= max_watched_directories) {
+      break;
+    }
+    if (std::ranges::find(paths, path) == paths.end()) {
+      paths.push_back(std::move(path));
+    }
+  }
+  watcher_.watch(paths);
+}
+
+void App::schedule_prefetch() {
+  std::vector<fs::path> paths;
+  if (state_.current_path_ != state_.current_path_.root_path()) {
+    auto parent_path = state_.current_path_.parent_path();
+    if (!state_.cache_.contains(parent_path)) {
+      paths.push_back(std::move(parent_path));
+    }
+  }
+  for (auto &path :
+       state_.nearby_directories(2 * prefetch_radius, prefetch_scan_rows)) {
+    if (!state_.cache_.contains(path)) {
+      paths.push_back(std::move(path));
+    }
+  }
+
+  if (paths.empty()) {
+    prefetcher_.cancel();
+  } else {
+    prefetcher_.prefetch(paths, state_.sort_mode_);
+  }
+}
+
+// Folds the moves queued right behind `event` into it, so a held key costs
+// one cursor update per wakeup of the event thread instead of one per repeat
+std::ptrdiff_t App::navigation_delta(const RenderEvent &event) {
+  auto step = [](const AppEvent &next) -> std::ptrdiff_t {
+    const auto *render = std::get_if<RenderEvent>(&next);
+    if (render == nullptr) {
+      return 0;
+    }
+    switch (render->type_) {
+    case RenderEvent::Type::MoveIndexDown:
+      return 1;
+    case RenderEvent::Type::MoveIndexUp:
+      return -1;
+    default:
+      return 0;
+    }
+  };
+
+  auto delta = step(event);
+  while (auto next = event_bus_.try_pop_event_if(
+             [&step](const AppEvent &next) { return step(next) != 0; })) {
+    delta += step(next.value());
+  }
+  return delta;
+}
+
+// The preview and prefetching wait for the cursor to settle
+void App::move_index(std::ptrdiff_t delta) {
+  state_.move_index(delta);
   ui_.async_update_index(state_.index_);
+  // The preview in flight is for the entry just left, only the next request
+  // waits for the cursor to settle
+  file_manager_.cancel_preview();
+  preview_due_ = std::chrono::steady_clock::now() + preview_settle_interval;
+}
+
+void App::settle_cursor() {
   update_preview();
+  schedule_prefetch();
 }
 
 void App::refresh_menu() {
-  ui_.async_update_info({state_.current_path_.string(), state_.index_,
-                         state_.current_directory_elements()});
+  auto title = state_.current_path_.string();
+  if (auto directory = state_.cache_.get(state_.current_path_);
+      directory && directory.value()->sort_mode_ != SortMode::Name) {
+    title += " (by " + sort_mode_name(directory.value()->sort_mode_) + ")";
+  }
+  ui_.async_update_info(
+      {std::move(title), state_.index_, state_.current_rows()});
 }
 
 void App::toggle_selection() {
@@ -190,7 +469,7 @@ void App::toggle_selection() {
     } else {
       state_.selected_entries_.insert(entry.value());
     }
-    move_index_down();
+    move_index(1);
   }
   refresh_menu();
 }
@@ -200,7 +479,28 @@ void App::toggle_hidden() {
   refresh_menu();
 }
 
+void App::cycle_sort_mode() {
+  auto mode = static_cast<SortMode>(
+      (static_cast<size_t>(state_.sort_mode_) + 1) % sort_mode_count);
+  state_.sort_mode_ = mode;
+  file_manager_.set_sort_mode(mode);
+
+  auto directory = state_.cache_.get(state_.current_path_);
+  if (!directory) {
+    return;
+  }
+  if (needs_metadata(mode) && !directory.value()->table_.has_metadata()) {
+    file_manager_.async_sort_directory(*directory.value(), mode);
+    return;
+  }
+  state_.sort_directory(state_.current_path_, mode);
+  refresh_menu();
+}
+
 void App::update_preview() {
+  // Whatever gets shown below supersedes a preview still being built
+  preview_due_.reset();
+  file_manager_.cancel_preview();
   auto entry_opt = state_.indexed_entry();
   if (!entry_opt) {
     ui_.async_update_preview("[No item selected]");
@@ -214,37 +514,74 @@ void App::update_preview() {
     return;
   }
 
-  if (auto entries = state_.get_entries(entry.path())) {
-    ui_.async_update_preview(
-        ftxui::vbox(state_.entries_to_elements(entries.value())));
+  auto [width, height] = ftxui::Terminal::Size();
+  auto elements =
+      state_.directory_elements(entry.path(), static_cast<size_t>(height));
+  if (entry.is_directory()) {
+    record_access(entry.path(), elements.has_value());
+  }
+  if (elements) {
+    revalidate(entry.path());
+    ui_.async_update_preview(ftxui::vbox(std::move(elements.value())));
     return;
   }
 
-  auto [width, height] = ftxui::Terminal::Size();
+  // Inside the preview window's border
+  auto size = std::pair{width / 2 - 2, height - 4};
+  std::uint64_t offset = 0;
+  if (preview_offset_ && preview_offset_->first == entry.path()) {
+    offset = preview_offset_->second;
+  } else {
+    preview_offset_.reset();
+  }
+  if (auto cached = file_manager_.cached_preview(entry, size, offset)) {
+    ui_.async_update_preview(std::move(cached.value()));
+    return;
+  }
   ui_.async_update_preview("Loading...");
-  file_manager_.async_update_preview(entry, {width / 2, height - 4});
+  file_manager_.async_update_preview(entry, size, offset);
 }
 
 void App::enter_directory() {
   state_.indexed_entry().transform([this](const auto &entry) {
     if (entry.is_directory()) {
-      if (state_.cache_.get(entry.path())) {
+      auto cached = state_.cache_.contains(entry.path());
+      record_access(entry.path(), cached);
+      if (cached) {
+        cancel_entering();
         update_current_direcotry(entry.path());
       } else {
-        file_manager_.async_enter_directory(entry.path());
+        start_entering(entry.path());
       }
     }
     return entry;
   });
 }
 
+// Supersedes a directory still being entered. A listing cut short keeps
+// its partial mark, so the next visit reloads it.
+void App::start_entering(const fs::path &path) {
+  entering_ = path;
+  streaming_.reset();
+  file_manager_.async_enter_directory(path);
+}
+
+void App::cancel_entering() {
+  entering_.reset();
+  streaming_.reset();
+  file_manager_.cancel_enter();
+}
+
 void App::leave_directory() {
   if (state_.current_path_ != state_.current_path_.root_path()) {
     auto parent_path = state_.current_path_.parent_path();
-    if (state_.cache_.get(parent_path)) {
+    auto cached = state_.cache_.contains(parent_path);
+    record_access(parent_path, cached);
+    if (cached) {
+      cancel_entering();
       update_current_direcotry(parent_path);
     } else {
-      file_manager_.async_enter_directory(parent_path);
+      start_entering(parent_path);
     }
   }
 }
@@ -328,6 +665,8 @@ void App::toggle_rename_dialog() {
 
 void App::toggle_notification() { ui_.async_toggle_notification(); }
 
+void App::toggle_jump_dialog() { ui_.async_toggle_jump_dialog(); }
+
 void App::clear_marks() {
   state_.selected_entries_.clear();
   refresh_menu();
@@ -343,6 +682,16 @@ void App::confirm_rename() {
   }
 }
 
+void App::confirm_jump() {
+  auto offset = parse_offset(ui_.input_content());
+  auto entry = state_.indexed_entry();
+  if (offset && entry && !entry.value().is_directory()) {
+    preview_offset_ = std::pair{entry.value().path(), offset.value()};
+    update_preview();
+  }
+  ui_.async_toggle_jump_dialog();
+}
+
 void App::open_file() {
   const static std::unordered_map<std::string, std::string> handlers = {
       {".txt", "nvim"},       {".cpp", "nvim"},  {".c", "nvim"},
@@ -1,62 +1,175 @@
 #include "app_state.hpp"
 #include "colorscheme.hpp"
+#include "memory_pressure.hpp"
 #include "utils.hpp"
 #include <algorithm>
+#include <charconv>
+#include <cstdlib>
 #include <ftxui/dom/elements.hpp>
 #include <ftxui/dom/node.hpp>
 #include <iterator>
 #include <ranges>
+#include <string_view>
+#include <utility>
 
 namespace duck {
 namespace fs = std::filesystem;
 
-AppState::AppState() : cache_(lru_cache_size) {}
+namespace {
 
-std::vector<ftxui::Element> AppState::entries_to_elements(
-    const std::vector<fs::directory_entry> &entries) const {
-  return entries |
-         std::views::transform([this](const fs::directory_entry &entry) {
-           auto filename = ftxui::text(entry_icon(entry) + " " +
-                                       entry.path().filename().string());
-           auto marker = ftxui::text("  ");
-           if (selected_entries_.contains(entry)) {
-             marker = ftxui::text("█ ");
-             if (is_yanking_) {
-               marker = marker | ftxui::color(ftxui::Color::Blue);
-             } else if (is_cutting_) {
-               marker = marker | ftxui::color(ftxui::Color::Red);
-             }
-           }
-           auto elmt = ftxui::hbox({marker, filename});
-           if (entry.is_directory()) {
-             elmt |= ftxui::color(ColorScheme::dir());
-           } else {
-             elmt |= ftxui::color(ColorScheme::file());
-           }
-           return elmt;
+size_t cache_budget() {
+  if (const auto *megabytes = std::getenv("DUCK_CACHE_MB")) {
+    size_t value = 0;
+    std::string_view text{megabytes};
+    if (std::from_chars(text.data(), text.data() + text.size(), value).ec ==
+            std::errc{} &&
+        value > 0) {
+      return value << 20U;
+    }
+  }
+  return default_cache_budget;
+}
+
+} // namespace
+
+AppState::AppState()
+    : cache_(lru_cache_size, cache_budget(), [](const DirectoryPtr &directory) {
+        return directory->memory_bytes();
+      }) {}
+
+void AppState::cache_directory(Directory directory) {
+  auto path = directory.path_;
+  cache_.insert(std::move(path),
+                std::make_shared<const Directory>(std::move(directory)));
+  shed_under_pressure();
+}
+
+void AppState::pin_current() {
+  std::vector<fs::path> paths{current_path_};
+  if (current_path_ != current_path_.root_path()) {
+    paths.push_back(current_path_.parent_path());
+  }
+  cache_.pin(std::move(paths));
+}
+
+// Under memory pressure the cache gives back half of what it holds. Listings
+// are cheap to reload compared to the rest of the system swapping.
+void AppState::shed_under_pressure() {
+  auto now = std::chrono::steady_clock::now();
+  if (now - pressure_checked_at_ < memory_pressure_interval) {
+    return;
+  }
+  pressure_checked_at_ = now;
+
+  if (auto pressure = memory_pressure();
+      pressure && pressure.value() >= memory_pressure_threshold) {
+    cache_.shrink_to(cache_.weight() / 2);
+    ++sheds_;
+  }
+}
+
+CacheStats AppState::cache_stats() {
+  return {.bytes_ = cache_.weight(),
+          .budget_ = cache_.budget(),
+          .sheds_ = sheds_};
+}
+
+namespace {
+
+ftxui::Element row_element(const Directory &directory, Row row,
+                           const std::set<Entry> &marked, bool is_yanking,
+                           bool is_cutting) {
+  const auto &table = directory.table_;
+  auto name = table.name(row);
+  auto icon = file_icon(table.file_class(row));
+  std::string label;
+  label.reserve(icon.size() + 1 + name.size());
+  label.append(icon).append(" ").append(name);
+  auto filename = ftxui::text(std::move(label));
+  auto marker = ftxui::text("  ");
+  if (!marked.empty() && marked.contains(directory.entry(row))) {
+    marker = ftxui::text("█ ");
+    if (is_yanking) {
+      marker = marker | ftxui::color(ftxui::Color::Blue);
+    } else if (is_cutting) {
+      marker = marker | ftxui::color(ftxui::Color::Red);
+    }
+  }
+  auto elmt = ftxui::hbox({marker, filename});
+  if (table.is_directory(row)) {
+    elmt |= ftxui::color(ColorScheme::dir());
+  } else {
+    elmt |= ftxui::color(ColorScheme::file());
+  }
+  return elmt;
+}
+
+} // namespace
+
+ftxui::Element AppState::entry_element(const Directory &directory,
+                                       Row row) const {
+  return row_element(directory, row, selected_entries_, is_yanking_,
+                     is_cutting_);
+}
+
+std::vector<ftxui::Element>
+AppState::entries_to_elements(const Directory &directory,
+                              std::span<const Row> rows) const {
+  return rows | std::views::transform([this, &directory](Row row) {
+           return entry_element(directory, row);
          }) |
          std::ranges::to<std::vector>();
 }
 
-std::vector<ftxui::Element> AppState::current_directory_elements() {
-  if (auto entries = get_entries(current_path_)) {
-    return entries_to_elements(entries.value());
+// The first `limit` rows, enough to fill the preview pane
+std::optional<std::vector<ftxui::Element>>
+AppState::directory_elements(const fs::path &path, size_t limit) {
+  auto directory = cache_.get(path);
+  if (!directory) {
+    return std::nullopt;
   }
+  auto rows = visible_rows(*directory.value());
+  return entries_to_elements(*directory.value(),
+                             rows.first(std::min(limit, rows.size())));
+}
 
-  return {ftxui::text("[Empty folder]")};
+// Shares the cached listing with the UI thread and copies only the marks
+// inside it, so this is cheap whatever the size of the directory.
+MenuRows AppState::current_rows() {
+  auto directory = cache_.get(current_path_);
+  if (!directory) {
+    return {};
+  }
+
+  auto listing = std::move(directory.value());
+  auto marked = std::make_shared<std::set<Entry>>();
+  for (const auto &entry : selected_entries_) {
+    if (entry.path().parent_path() == current_path_) {
+      marked->insert(entry);
+    }
+  }
+  auto rows = visible_rows(*listing);
+  return {.size_ = rows.size(),
+          .row_ = [listing, rows, marked = std::move(marked),
+                   is_yanking = is_yanking_,
+                   is_cutting = is_cutting_](size_t index) {
+            return row_element(*listing, rows[index], *marked, is_yanking,
+                               is_cutting);
+          }};
 }
 
 std::vector<ftxui::Element> AppState::selected_entries_elements() {
   if (selected_entries_.empty()) {
-    return entries_to_elements({indexed_entry().value()});
+    auto directory = cache_.get(current_path_).value();
+    return {entry_element(*directory, visible_row(*directory, index_).value())};
   }
 
-  auto entries = std::vector<fs::directory_entry>{selected_entries_.begin(),
-                                                  selected_entries_.end()};
-  return entries |
-         std::views::transform([this](const fs::directory_entry &entry) {
+  auto entries =
+      std::vector<Entry>{selected_entries_.begin(), selected_entries_.end()};
+  return entries | std::views::transform([](const Entry &entry) {
            auto filename =
-               ftxui::text(entry_icon(entry) + " " + entry.path().string());
+               ftxui::text(std::string{entry_icon(entry)} + " " +
+                           entry.path().string());
            auto marker = ftxui::text("  ");
            auto elmt = ftxui::hbox({marker, filename});
            if (entry.is_directory()) {
@@ -70,31 +183,29 @@ std::vector<ftxui::Element> AppState::selected_entries_elements() {
 }
 
 size_t AppState::entries_size(const fs::path &path) {
-  auto directory_opt = cache_.get(path);
-  if (!directory_opt) {
+  auto directory = cache_.get(path);
+  if (!directory) {
     return 0;
   }
-  const auto &directory = directory_opt.value();
-  if (show_hidden_) {
-    return directory.entries_.size() + directory.hidden_entries_.size();
-  }
-  return directory.entries_.size();
+  return visible_count(*directory.value());
+}
+
+size_t AppState::visible_count(const Directory &directory) const {
+  return directory.rows(show_hidden_).size();
 }
 
-std::optional<std::vector<fs::directory_entry>>
-AppState::get_entries(const fs::path &path) {
-  auto directory_opt = cache_.get(path);
-  if (!directory_opt) {
+std::optional<Row> AppState::visible_row(const Directory &directory,
+                                         size_t index) const {
+  auto rows = directory.rows(show_hidden_);
+  if (index >= rows.size()) {
     return std::nullopt;
   }
-  auto directory = directory_opt.value();
-  auto entries = directory.entries_;
-  if (show_hidden_) {
-    entries.reserve(entries.size() + directory.hidden_entries_.size());
-    std::ranges::copy(directory.hidden_entries_, std::back_inserter(entries));
-    std::ranges::sort(entries, entries_sorter);
-  }
-  return entries;
+  return rows[index];
+}
+
+std::span<const Row>
+AppState::visible_rows(const Directory &directory) const {
+  return directory.rows(show_hidden_);
 }
 
 std::vector<fs::path> AppState::selected_entries_paths() {
@@ -113,98 +224,252 @@ std::vector<fs::path> AppState::selected_entries_paths() {
   return paths;
 }
 
-std::optional<fs::directory_entry> AppState::indexed_entry() {
-  if (auto entries = get_entries(current_path_)) {
-    if (index_ < entries.value().size()) {
-      return entries.value()[index_];
+// Directories around the cursor, nearest first, looking at most `scan_rows`
+// rows away in each direction.
+std::vector<fs::path> AppState::nearby_directories(size_t count,
+                                                   size_t scan_rows) {
+  std::vector<fs::path> paths;
+  auto directory = cache_.get(current_path_);
+  if (!directory) {
+    return paths;
+  }
+
+  const auto &listing = *directory.value();
+  auto consider = [&](size_t index) {
+    if (paths.size() == count) {
+      return;
+    }
+    if (auto row = visible_row(listing, index);
+        row && listing.table_.is_directory(row.value())) {
+      paths.push_back(listing.entry(row.value()).path());
+    }
+  };
+  for (size_t distance = 1; distance <= scan_rows && paths.size() < count;
+       ++distance) {
+    consider(index_ + distance);
+    if (index_ >= distance) {
+      consider(index_ - distance);
     }
   }
-  return std::nullopt;
+  return paths;
 }
 
-void AppState::move_index_down() {
-  auto size = entries_size(current_path_);
-  if (size > 0) {
-    index_ = (index_ + 1) % size;
+std::optional<Entry> AppState::indexed_entry() {
+  if (auto directory = cache_.get(current_path_)) {
+    if (auto row = visible_row(*directory.value(), index_)) {
+      return directory.value()->entry(row.value());
+    }
   }
+  return std::nullopt;
 }
 
-void AppState::move_index_up() {
-  auto size = entries_size(current_path_);
+void AppState::move_index(std::ptrdiff_t delta) {
+  auto size = static_cast<std::ptrdiff_t>(entries_size(current_path_));
   if (size > 0) {
-    index_ = (index_ + size - 1) % size;
+    auto index = static_cast<std::ptrdiff_t>(index_) + delta % size;
+    index_ = static_cast<size_t>((index + size) % size);
   }
 }
 
+void AppState::move_index_down() { move_index(1); }
+
+void AppState::move_index_up() { move_index(-1); }
+
+// Both views are sorted the same way, so the focused row is found in the
+// other one by binary search. A hidden row being hidden leaves the cursor on
+// the entry that followed it.
 void AppState::toggle_hidden() {
-  auto entry_opt = indexed_entry();
+  auto directory = cache_.get(current_path_);
+  auto row = directory ? visible_row(*directory.value(), index_)
+                       : std::optional<Row>{};
 
   show_hidden_ = !show_hidden_;
 
-  if (entry_opt.has_value()) {
-    const auto &current_entry = entry_opt.value();
-    if (auto entries = get_entries(current_path_)) {
-      auto it = std::ranges::find(
-          entries.value(), current_entry.path(),
-          [](const fs::directory_entry &e) { return e.path(); });
-
-      if (it != entries.value().end()) {
-        index_ = std::distance(entries.value().begin(), it);
-      } else {
-        index_ = 0;
-      }
+  index_ = 0;
+  if (!row) {
+    return;
+  }
+  const auto &listing = *directory.value();
+  auto rows = visible_rows(listing);
+  auto less = [&listing](Row first, Row second) {
+    return listing.less(first, second);
+  };
+  auto it = std::ranges::lower_bound(rows, row.value(), less);
+  while (it != rows.end() && *it != row.value() && !less(row.value(), *it)) {
+    ++it;
+  }
+  index_ = std::min<size_t>(std::distance(rows.begin(), it),
+                            rows.empty() ? 0 : rows.size() - 1);
+}
+
+bool AppState::focus_entry(const fs::path &path) {
+  index_ = 0;
+  if (auto directory = cache_.get(current_path_)) {
+    const auto &table = directory.value()->table_;
+    auto rows = visible_rows(*directory.value());
+    auto filename = path.filename();
+    auto it = std::ranges::find(rows, std::string_view{filename.native()},
+                                [&table](Row row) { return table.name(row); });
+
+    if (it != rows.end()) {
+      index_ = std::distance(rows.begin(), it);
+      return true;
     }
-  } else {
-    index_ = 0;
+  }
+  return false;
+}
+
+void AppState::merge_entries(const fs::path &path,
+                             const DirectoryTable &chunk) {
+  auto focused =
+      path == current_path_ ? indexed_entry() : std::optional<Entry>{};
+  if (!update_directory(path, [&chunk](Directory &directory) {
+        directory.merge(chunk);
+      })) {
+    return;
+  }
+  if (focused) {
+    focus_entry(focused.value().path());
+  }
+}
+
+void AppState::commit_directory(Directory directory) {
+  auto focused = directory.path_ == current_path_ ? indexed_entry()
+                                                  : std::optional<Entry>{};
+  cache_directory(std::move(directory));
+  if (focused) {
+    focus_entry(focused.value().path());
+  }
+}
+
+void AppState::sort_directory(const fs::path &path, SortMode mode) {
+  if (auto directory = cache_.get(path)) {
+    auto sorted = *directory.value();
+    sorted.set_sort_mode(mode);
+    commit_directory(std::move(sorted));
   }
 }
 
 void AppState::remove_entries(const std::vector<fs::path> &paths) {
   for (const auto &path : paths) {
-    if (auto directory = cache_.get(path.parent_path());
-        directory.has_value()) {
-      auto pred = [path](const auto &entry) { return entry.path() == path; };
-      std::erase_if(directory.value().entries_, pred);
-      std::erase_if(directory.value().hidden_entries_, pred);
-      cache_.insert(std::move(path.parent_path()),
-                    std::move(directory.value()));
-    }
+    update_directory(path.parent_path(), [&path](Directory &directory) {
+      directory.remove_entry(path.filename().native());
+    });
   }
 }
 
 void AppState::rename_entry(const fs::path &old_name,
                             const fs::path &new_name) {
-  if (auto directory_opt = cache_.get(old_name.parent_path()); directory_opt) {
-    auto directory = directory_opt.value();
-    auto pred = [old_name](const auto &entry) {
-      return entry.path() == old_name;
-    };
-
-    std::erase_if(directory.entries_, pred);
-    std::erase_if(directory.hidden_entries_, pred);
-    if (new_name.filename().string().starts_with('.')) {
-      directory.hidden_entries_.emplace_back(new_name);
-      std::ranges::sort(directory.hidden_entries_, entries_sorter);
-    } else {
-      directory.entries_.emplace_back(new_name);
-      std::ranges::sort(directory.entries_, entries_sorter);
+  update_directory(old_name.parent_path(), [&](Directory &directory) {
+    directory.rename_entry(old_name.filename().native(),
+                           new_name.filename().native());
+  });
+}
+
+void AppState::create_entry(const fs::path &new_entry, bool is_directory) {
+  auto type = is_directory ? fs::file_type::directory : fs::file_type::regular;
+  update_directory(new_entry.parent_path(), [&](Directory &directory) {
+    directory.insert_entry(new_entry.filename().native(), type);
+  });
+}
+
+void AppState::apply_changes(const fs::path &path,
+                             const std::vector<FsChange> &changes,
+                             std::optional<DirectoryStamp> stamp) {
+  auto cached = cache_.get(path);
+  if (!cached) {
+    return;
+  }
+
+  auto directory = *cached.value();
+  auto is_current = path == current_path_;
+  auto focused = is_current ? indexed_entry() : std::optional<Entry>{};
+
+  auto create = [&directory](std::string_view name, const FsChange &change) {
+    directory.remove_entry(name);
+    auto row =
+        directory.insert_entry(name, change.file_type_, change.is_symlink_);
+    if (directory.table_.has_metadata()) {
+      directory.set_metadata(row, change.size_, change.mtime_);
+    }
+  };
+
+  for (const auto &change : changes) {
+    switch (change.type_) {
+    case FsChange::Type::Created:
+      create(change.name_, change);
+      break;
+    case FsChange::Type::Deleted:
+      directory.remove_entry(change.name_);
+      break;
+    case FsChange::Type::Renamed:
+      if (!directory.rename_entry(change.name_, change.new_name_)) {
+        create(change.new_name_, change);
+      }
+      break;
+    case FsChange::Type::Modified:
+      if (auto row = directory.find(change.name_);
+          row && directory.table_.has_metadata()) {
+        directory.set_metadata(row.value(), change.size_, change.mtime_);
+      }
+      break;
     }
-    cache_.insert(old_name.parent_path(), directory);
+  }
+
+  directory.stamp_ = stamp;
+  cache_directory(std::move(directory));
+  if (!is_current) {
+    return;
+  }
+
+  // Follow the focused entry, or stay in place when it went away
+  auto previous_index = index_;
+  if (!focused || !focus_entry(focused.value().path())) {
+    auto size = entries_size(path);
+    index_ = size == 0 ? 0 : std::min(previous_index, size - 1);
   }
 }
 
-void AppState::create_entry(const fs::path &new_entry) {
-  auto parent_path = new_entry.parent_path();
-  if (auto directory_opt = cache_.get(parent_path); directory_opt.has_value()) {
-    auto directory = directory_opt.value();
-    if (new_entry.filename().string().starts_with('.')) {
-      directory.hidden_entries_.emplace_back(new_entry);
-      std::ranges::sort(directory.hidden_entries_, entries_sorter);
-    } else {
-      directory.entries_.emplace_back(new_entry);
-      std::ranges::sort(directory.entries_, entries_sorter);
+// Compares the cached listing's stamp with one statx of the directory. Each
+// path is checked at most once per revalidation_interval, listings without a
+// stamp are taken as they are and partial ones are always stale.
+bool AppState::is_stale(const fs::path &path) {
+  auto cached = cache_.peek(path, [](const DirectoryPtr &directory) {
+    return std::pair{directory->stamp_, directory->partial_};
+  });
+  if (!cached) {
+    return false;
+  }
+  auto [stamp, partial] = cached.value();
+  if (partial) {
+    ++revalidation_stats_.stale_hits_;
+    return true;
+  }
+  if (!stamp) {
+    return false;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  auto [it, inserted] = revalidated_at_.try_emplace(path, now);
+  if (!inserted) {
+    if (now - it->second < revalidation_interval) {
+      ++revalidation_stats_.rate_limited_;
+      return false;
     }
-    cache_.insert(parent_path, directory);
+    it->second = now;
+  }
+  if (revalidated_at_.size() > 2 * lru_cache_size) {
+    std::erase_if(revalidated_at_, [now](const auto &item) {
+      return now - item.second >= revalidation_interval;
+    });
   }
+
+  ++revalidation_stats_.revalidations_;
+  if (stamp_directory(path) == stamp.value()) {
+    return false;
+  }
+  ++revalidation_stats_.stale_hits_;
+  return true;
 }
+
 } // namespace duck
@@ -0,0 +1,567 @@
+#include "archive_lister.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <fcntl.h>
+#include <span>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace duck {
+
+namespace {
+
+constexpr std::uint32_t zip_entry_signature = 0x02014b50;
+constexpr std::uint32_t zip_end_signature = 0x06054b50;
+constexpr std::uint32_t zip64_end_signature = 0x06064b50;
+constexpr std::uint32_t zip64_locator_signature = 0x07064b50;
+constexpr std::uint16_t zip64_extra_id = 0x0001;
+constexpr size_t zip_entry_size = 46;
+constexpr size_t zip_end_size = 22;
+constexpr size_t zip64_end_size = 56;
+constexpr size_t zip64_locator_size = 20;
+// The end record may be followed by a comment this long
+constexpr size_t zip_comment_limit = 0xffff;
+
+constexpr size_t tar_block_size = 512;
+constexpr size_t tar_checksum_offset = 148;
+constexpr size_t tar_checksum_size = 8;
+
+// Closes the file when done
+class File {
+private:
+  int fd_;
+
+public:
+  explicit File(const fs::path &path)
+      : fd_{open(path.c_str(), O_RDONLY | O_CLOEXEC)} {}
+  ~File() {
+    if (fd_ != -1) {
+      close(fd_);
+    }
+  }
+  File(const File &) = delete;
+  File &operator=(const File &) = delete;
+
+  [[nodiscard]] bool is_open() const { return fd_ != -1; }
+
+  [[nodiscard]] std::uint64_t size() const {
+    struct stat st{};
+    return fstat(fd_, &st) == -1 ? 0 : static_cast<std::uint64_t>(st.st_size);
+  }
+
+  // Fills `bytes` unless the file ends first; the number of bytes read
+  size_t read(std::span<std::uint8_t> bytes, std::uint64_t offset) const {
+    size_t read = 0;
+    while (read < bytes.size()) {
+      auto got = pread(fd_, bytes.data() + read, bytes.size() - read,
+                       static_cast<off_t>(offset + read));
+      if (got <= 0) {
+        break;
+      }
+      read += static_cast<size_t>(got);
+    }
+    return read;
+  }
+};
+
+template <typename T> T load_le(const std::uint8_t *bytes) {
+  T value = 0;
+  for (size_t i = sizeof(T); i-- > 0;) {
+    value = static_cast<T>((value << 8U) | bytes[i]);
+  }
+  return value;
+}
+
+// Size from the zip64 extra field, which holds it when the 32-bit field is
+// 0xffffffff
+std::optional<std::uint64_t> zip64_size(std::span<const std::uint8_t> extra) {
+  while (extra.size() >= 4) {
+    auto id = load_le<std::uint16_t>(extra.data());
+    auto length = size_t{load_le<std::uint16_t>(extra.data() + 2)};
+    if (length > extra.size() - 4) {
+      break;
+    }
+    if (id == zip64_extra_id && length >= 8) {
+      return load_le<std::uint64_t>(extra.data() + 4);
+    }
+    extra = extra.subspan(4 + length);
+  }
+  return std::nullopt;
+}
+
+struct ZipDirectory {
+  std::uint64_t offset_ = 0;
+  std::uint64_t size_ = 0;
+  std::uint64_t entries_ = 0;
+};
+
+// Where the central directory is, from the end record in the last 64 KiB
+std::optional<ZipDirectory> find_zip_directory(const File &file) {
+  auto size = file.size();
+  if (size < zip_end_size) {
+    return std::nullopt;
+  }
+  auto tail_size = std::min<std::uint64_t>(size, zip_end_size +
+                                                     zip_comment_limit);
+  auto tail_start = size - tail_size;
+  std::vector<std::uint8_t> tail(static_cast<size_t>(tail_size));
+  if (file.read(tail, tail_start) != tail.size()) {
+    return std::nullopt;
+  }
+
+  // The last signature whose comment fits: comments may contain one too
+  std::optional<size_t> end;
+  for (auto i = tail.size() - zip_end_size + 1; i-- > 0;) {
+    if (load_le<std::uint32_t>(tail.data() + i) == zip_end_signature &&
+        load_le<std::uint16_t>(tail.data() + i + 20) <=
+            tail.size() - i - zip_end_size) {
+      end = i;
+      break;
+    }
+  }
+  if (!end) {
+    return std::nullopt;
+  }
+  const auto *record = tail.data() + end.value();
+  ZipDirectory directory{.offset_ = load_le<std::uint32_t>(record + 16),
+                         .size_ = load_le<std::uint32_t>(record + 12),
+                         .entries_ = load_le<std::uint16_t>(record + 10)};
+  auto end_position = tail_start + end.value();
+
+  auto is_zip64 = directory.entries_ == 0xffff ||
+                  directory.size_ == 0xffffffff ||
+                  directory.offset_ == 0xffffffff;
+  if (is_zip64 && end.value() >= zip64_locator_size) {
+    const auto *locator = record - zip64_locator_size;
+    if (load_le<std::uint32_t>(locator) == zip64_locator_signature) {
+      std::array<std::uint8_t, zip64_end_size> record64{};
+      end_position = load_le<std::uint64_t>(locator + 8);
+      if (file.read(record64, end_position) != record64.size() ||
+          load_le<std::uint32_t>(record64.data()) != zip64_end_signature) {
+        return std::nullopt;
+      }
+      directory = {.offset_ = load_le<std::uint64_t>(record64.data() + 48),
+                   .size_ = load_le<std::uint64_t>(record64.data() + 40),
+                   .entries_ = load_le<std::uint64_t>(record64.data() + 32)};
+    }
+  }
+  if (directory.offset_ > end_position ||
+      directory.size_ > end_position - directory.offset_) {
+    return std::nullopt;
+  }
+  return directory;
+}
+
+std::string_view tar_string(std::span<const std::uint8_t> field) {
+  std::string_view text{reinterpret_cast<const char *>(field.data()),
+                        field.size()};
+  return text.substr(0, text.find('\0'));
+}
+
+// Octal, or base-256 with the high bit of the first byte set, which GNU tar
+// writes for sizes from 8 GiB
+std::optional<std::uint64_t> tar_number(std::span<const std::uint8_t> field) {
+  std::uint64_t value = 0;
+  if ((field[0] & 0x80U) != 0) {
+    for (size_t i = 1; i < field.size(); ++i) {
+      value = (value << 8U) | field[i];
+    }
+    return value;
+  }
+  auto text = tar_string(field);
+  auto first = text.find_first_not_of(' ');
+  if (first == std::string_view::npos) {
+    return 0;
+  }
+  text = text.substr(first, text.find_last_not_of(' ') - first + 1);
+  const auto *end = text.data() + text.size();
+  auto [last, error] = std::from_chars(text.data(), end, value, 8);
+  if (error != std::errc{} || last != end) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+// The checksum field counts as spaces. Some old tars summed signed bytes.
+bool valid_checksum(std::span<const std::uint8_t> header) {
+  auto stored =
+      tar_number(header.subspan(tar_checksum_offset, tar_checksum_size));
+  if (!stored) {
+    return false;
+  }
+  std::uint64_t sum = ' ' * tar_checksum_size;
+  std::int64_t signed_sum = ' ' * tar_checksum_size;
+  for (size_t i = 0; i < header.size(); ++i) {
+    if (i < tar_checksum_offset ||
+        i >= tar_checksum_offset + tar_checksum_size) {
+      sum += header[i];
+      signed_sum += static_cast<std::int8_t>(header[i]);
+    }
+  }
+  return stored.value() == sum ||
+         static_cast<std::int64_t>(stored.value()) == signed_sum;
+}
+
+// "path" and "size" from pax records, each "<length> <key>=<value>\n"
+void read_pax(std::string_view records, std::string &name,
+              std::optional<std::uint64_t> &size) {
+  while (!records.empty()) {
+    size_t length = 0;
+    auto [last, error] =
+        std::from_chars(records.data(), records.data() + records.size(),
+                        length);
+    auto skipped = static_cast<size_t>(last - records.data());
+    if (error != std::errc{} || length <= skipped + 1 ||
+        length > records.size()) {
+      return;
+    }
+    auto record = records.substr(skipped + 1, length - skipped - 2);
+    records.remove_prefix(length);
+    if (record.starts_with("path=")) {
+      name = record.substr(5);
+    } else if (record.starts_with("size=")) {
+      std::uint64_t value = 0;
+      auto digits = record.substr(5);
+      if (std::from_chars(digits.data(), digits.data() + digits.size(), value)
+              .ec == std::errc{}) {
+        size = value;
+      }
+    }
+  }
+}
+
+// A tar read straight from the file: payloads are seeked over
+class TarFile {
+private:
+  const File &file_;
+  std::uint64_t position_ = 0;
+
+public:
+  explicit TarFile(const File &file) : file_{file} {}
+
+  bool read(std::span<std::uint8_t> bytes) {
+    auto read = file_.read(bytes, position_);
+    position_ += read;
+    return read == bytes.size();
+  }
+
+  // Past the end, the next read fails
+  bool skip(std::uint64_t count) {
+    position_ += count;
+    return true;
+  }
+};
+
+// A tar inside gzip, inflated as it is read. Payloads are inflated into
+// scratch space and dropped, since deflate can't be seeked.
+class GzipTar {
+private:
+  const File &file_;
+  const std::function<bool()> &stopped_;
+  z_stream stream_{};
+  bool initialized_;
+  std::uint64_t position_ = 0;
+  std::vector<std::uint8_t> input_;
+  std::vector<std::uint8_t> scratch_;
+
+public:
+  GzipTar(const File &file, const std::function<bool()> &stopped)
+      : file_{file}, stopped_{stopped},
+        initialized_{inflateInit2(&stream_, 16 + MAX_WBITS) == Z_OK},
+        input_(archive_read_size) {}
+  ~GzipTar() {
+    if (initialized_) {
+      inflateEnd(&stream_);
+    }
+  }
+  GzipTar(const GzipTar &) = delete;
+  GzipTar &operator=(const GzipTar &) = delete;
+
+  bool read(std::span<std::uint8_t> bytes) {
+    if (!initialized_) {
+      return false;
+    }
+    stream_.next_out = bytes.data();
+    stream_.avail_out = static_cast<uInt>(bytes.size());
+    while (stream_.avail_out > 0) {
+      if (stream_.avail_in == 0) {
+        auto read = file_.read(input_, position_);
+        if (read == 0) {
+          return false;
+        }
+        position_ += read;
+        stream_.next_in = input_.data();
+        stream_.avail_in = static_cast<uInt>(read);
+      }
+      auto result = inflate(&stream_, Z_NO_FLUSH);
+      // Concatenated members carry on the same tar
+      if (result == Z_STREAM_END) {
+        if (inflateReset(&stream_) != Z_OK) {
+          return false;
+        }
+      } else if (result != Z_OK && result != Z_BUF_ERROR) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool skip(std::uint64_t count) {
+    scratch_.resize(archive_read_size);
+    while (count > 0) {
+      if (stopped_()) {
+        return false;
+      }
+      auto chunk = static_cast<size_t>(
+          std::min<std::uint64_t>(count, scratch_.size()));
+      if (!read(std::span{scratch_}.first(chunk))) {
+        return false;
+      }
+      count -= chunk;
+    }
+    return true;
+  }
+};
+
+template <typename Source>
+std::optional<ArchiveListing> read_tar(Source &source, size_t limit,
+                                       const std::function<bool()> &stopped) {
+  ArchiveListing listing;
+  std::array<std::uint8_t, tar_block_size> header{};
+  // From GNU long name and pax headers, for the entry that follows
+  std::string long_name;
+  std::optional<std::uint64_t> long_size;
+  auto first = true;
+  while (listing.entries_.size() < limit) {
+    if (stopped()) {
+      return std::nullopt;
+    }
+    // A truncated tar lists what it has
+    if (!source.read(header)) {
+      break;
+    }
+    if (std::ranges::all_of(header, [](auto byte) { return byte == 0; })) {
+      listing.total_ = listing.entries_.size();
+      break;
+    }
+    auto size = tar_number(std::span{header}.subspan(124, 12));
+    if (!valid_checksum(header) || !size) {
+      if (first) {
+        return std::nullopt;
+      }
+      break;
+    }
+    first = false;
+
+    auto type = header[156];
+    auto padded = [](std::uint64_t size) {
+      return (size + tar_block_size - 1) / tar_block_size * tar_block_size;
+    };
+    if (type == 'L' || type == 'x') {
+      if (size.value() > tar_meta_limit) {
+        break;
+      }
+      std::string data(static_cast<size_t>(padded(size.value())), '\0');
+      if (!source.read(std::span{reinterpret_cast<std::uint8_t *>(
+                                     data.data()),
+                                 data.size()})) {
+        break;
+      }
+      data.resize(static_cast<size_t>(size.value()));
+      if (type == 'L') {
+        long_name = data.substr(0, data.find('\0'));
+      } else {
+        read_pax(data, long_name, long_size);
+      }
+      continue;
+    }
+    // A pax size replaces the one in the header
+    size = long_size.value_or(size.value());
+    if (!source.skip(padded(size.value()))) {
+      break;
+    }
+    // Global pax headers and GNU long link names describe no entry
+    if (type == 'g' || type == 'K') {
+      continue;
+    }
+
+    auto name = std::move(long_name);
+    if (name.empty()) {
+      name = tar_string(std::span{header}.first(100));
+      auto prefix = tar_string(std::span{header}.subspan(345, 155));
+      if (tar_string(std::span{header}.subspan(257, 6)) == "ustar" &&
+          !prefix.empty()) {
+        name = std::string{prefix} + "/" + name;
+      }
+    }
+    auto is_directory = type == '5' || name.ends_with('/');
+    if (is_directory && !name.ends_with('/')) {
+      name += '/';
+    }
+    listing.entries_.push_back({.name_ = std::move(name),
+                                .size_ = size.value(),
+                                .is_directory_ = is_directory});
+    long_name.clear();
+    long_size.reset();
+  }
+  if (first) {
+    return std::nullopt;
+  }
+  return listing;
+}
+
+// 512, 1.5K, 23M
+std::string format_size(std::uint64_t size) {
+  constexpr std::string_view units = "BKMGTPE";
+  if (size < 1024) {
+    return std::to_string(size);
+  }
+  auto value = static_cast<double>(size);
+  size_t unit = 0;
+  while (value >= 1024 && unit + 1 < units.size()) {
+    value /= 1024;
+    ++unit;
+  }
+  std::array<char, 16> buffer{};
+  auto [end, _] =
+      std::to_chars(buffer.data(), buffer.data() + buffer.size(), value,
+                    std::chars_format::fixed, value < 10 ? 1 : 0);
+  return std::string{buffer.data(), end} + units[unit];
+}
+
+} // namespace
+
+bool is_archive(ContentType type) {
+  return type == ContentType::Zip || type == ContentType::Tar ||
+         type == ContentType::Gzip;
+}
+
+std::optional<ArchiveListing> list_zip(const fs::path &path, size_t limit,
+                                       const std::function<bool()> &stopped) {
+  File file{path};
+  if (!file.is_open()) {
+    return std::nullopt;
+  }
+  auto directory = find_zip_directory(file);
+  if (!directory || stopped()) {
+    return std::nullopt;
+  }
+
+  ArchiveListing listing{.total_ = directory->entries_};
+  auto end = directory->offset_ + directory->size_;
+  std::vector<std::uint8_t> buffer;
+  std::uint64_t buffer_start = 0;
+  // [position, position + length) of the directory, read archive_read_size
+  // at a time
+  auto view = [&](std::uint64_t position,
+                  size_t length) -> const std::uint8_t * {
+    if (position >= buffer_start &&
+        position + length <= buffer_start + buffer.size()) {
+      return buffer.data() + (position - buffer_start);
+    }
+    if (length > end - position) {
+      return nullptr;
+    }
+    buffer.resize(static_cast<size_t>(std::max<std::uint64_t>(
+        length, std::min<std::uint64_t>(archive_read_size, end - position))));
+    buffer_start = position;
+    if (file.read(buffer, position) != buffer.size()) {
+      buffer.clear();
+      return nullptr;
+    }
+    return buffer.data();
+  };
+
+  auto position = directory->offset_;
+  while (listing.entries_.size() < limit &&
+         listing.entries_.size() < directory->entries_ && position < end) {
+    if (stopped()) {
+      return std::nullopt;
+    }
+    const auto *header = view(position, zip_entry_size);
+    if (header == nullptr ||
+        load_le<std::uint32_t>(header) != zip_entry_signature) {
+      if (listing.entries_.empty()) {
+        return std::nullopt;
+      }
+      break;
+    }
+    auto name_length = size_t{load_le<std::uint16_t>(header + 28)};
+    auto extra_length = size_t{load_le<std::uint16_t>(header + 30)};
+    auto comment_length = size_t{load_le<std::uint16_t>(header + 32)};
+    const auto *entry =
+        view(position, zip_entry_size + name_length + extra_length);
+    if (entry == nullptr) {
+      break;
+    }
+    std::string name{reinterpret_cast<const char *>(entry + zip_entry_size),
+                     name_length};
+    std::uint64_t size = load_le<std::uint32_t>(entry + 24);
+    if (size == 0xffffffff) {
+      size = zip64_size({entry + zip_entry_size + name_length, extra_length})
+                 .value_or(size);
+    }
+    auto is_directory = name.ends_with('/');
+    listing.entries_.push_back({.name_ = std::move(name),
+                                .size_ = size,
+                                .is_directory_ = is_directory});
+    position += zip_entry_size + name_length + extra_length + comment_length;
+  }
+  return listing;
+}
+
+std::optional<ArchiveListing> list_tar(const fs::path &path, bool gzipped,
+                                       size_t limit,
+                                       const std::function<bool()> &stopped) {
+  File file{path};
+  if (!file.is_open()) {
+    return std::nullopt;
+  }
+  if (gzipped) {
+    GzipTar source{file, stopped};
+    return read_tar(source, limit, stopped);
+  }
+  TarFile source{file};
+  return read_tar(source, limit, stopped);
+}
+
+std::optional<ArchiveListing>
+list_archive(const fs::path &path, ContentType type, size_t limit,
+             const std::function<bool()> &stopped) {
+  switch (type) {
+  case ContentType::Zip:
+    return list_zip(path, limit, stopped);
+  case ContentType::Tar:
+  case ContentType::Gzip:
+    return list_tar(path, type == ContentType::Gzip, limit, stopped);
+  default:
+    return std::nullopt;
+  }
+}
+
+TextLines archive_lines(const ArchiveListing &listing, size_t columns,
+                        size_t rows) {
+  auto count = listing.total_.value_or(listing.entries_.size());
+  std::string text = std::to_string(count);
+  text += count == 1 ? " entry" : " entries";
+  if (!listing.total_) {
+    text += " or more";
+  }
+  for (const auto &entry : listing.entries_) {
+    auto size = entry.is_directory_ ? std::string{} : format_size(entry.size_);
+    text += '\n';
+    text.append(size.size() < 6 ? 6 - size.size() : 0, ' ');
+    text += size;
+    text += "  ";
+    // One entry, one line
+    for (auto c : entry.name_) {
+      text += static_cast<unsigned char>(c) < 0x20 || c == 0x7f ? '?' : c;
+    }
+  }
+  return split_lines(text, columns, rows);
+}
+
+} // namespace duck
@@ -15,4 +15,22 @@ ftxui::Color ColorScheme::file() { return color_map_.at("file"); }
 
 ftxui::Color ColorScheme::dir() { return color_map_.at("dir"); }
 
+ftxui::Color ColorScheme::keyword() { return color_map_.at("keyword"); }
+
+ftxui::Color ColorScheme::string() { return color_map_.at("string"); }
+
+ftxui::Color ColorScheme::number() { return color_map_.at("number"); }
+
+ftxui::Color ColorScheme::comment() { return color_map_.at("comment"); }
+
+ftxui::Color ColorScheme::preprocessor() {
+  return color_map_.at("preprocessor");
+}
+
+ftxui::Color ColorScheme::key() { return color_map_.at("key"); }
+
+ftxui::Color ColorScheme::heading() { return color_map_.at("heading"); }
+
+ftxui::Color ColorScheme::code() { return color_map_.at("code"); }
+
 } // namespace duck
@@ -10,45 +10,46 @@
 #include <ftxui/screen/color.hpp>
 #include <ftxui/screen/screen.hpp>
 #include <ftxui/screen/terminal.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
 #include <ranges>
 #include <string>
 #include <utility>
 #include <variant>
+#include <vector>
 
 namespace duck {
 
-ftxui::Element
-ContentProvider::visible_entries(const std::vector<ftxui::Element> &all_entries,
-                                 const size_t &index) {
-  if (all_entries.empty()) {
+// Builds elements for the rows in the viewport only
+ftxui::Element ContentProvider::visible_entries(const MenuRows &rows,
+                                                const size_t &index) {
+  if (rows.size_ == 0) {
     return ftxui::text("[Empty folder]");
   }
 
-  auto [width, _] = ftxui::Terminal::Size();
-  std::vector<ftxui::Element> visible_entries;
-  size_t view_index = 0;
   // delete the border and margin space
   const size_t viewport_size = ftxui::Terminal::Size().dimy - 2;
 
-  if (all_entries.size() > viewport_size) {
-    size_t start_index = 0;
+  size_t start_index = 0;
+  size_t end_index = rows.size_;
+  if (rows.size_ > viewport_size) {
     if (index > viewport_size * 3 / 4) {
       start_index = index - viewport_size * 3 / 4;
     }
 
-    if (start_index + viewport_size > all_entries.size()) {
-      start_index = all_entries.size() - viewport_size;
+    if (start_index + viewport_size > rows.size_) {
+      start_index = rows.size_ - viewport_size;
     }
 
-    size_t end_index = start_index + viewport_size;
-    view_index = index - start_index;
+    end_index = start_index + viewport_size;
+  }
+  auto view_index = index - start_index;
 
-    visible_entries.assign(
-        std::make_move_iterator(all_entries.begin() + start_index),
-        std::make_move_iterator(all_entries.begin() + end_index));
-  } else {
-    visible_entries = all_entries;
-    view_index = index;
+  std::vector<ftxui::Element> visible_entries;
+  visible_entries.reserve(end_index - start_index);
+  for (auto row = start_index; row < end_index; ++row) {
+    visible_entries.push_back(rows.row_(row));
   }
   if (view_index < visible_entries.size()) {
     visible_entries[view_index] |= ftxui::color(ftxui::Color::Black) |
@@ -60,7 +61,7 @@ ContentProvider::visible_entries(const std::vector<ftxui::Element> &all_entries,
 ftxui::Element ContentProvider::left_pane(const MenuInfo &info) {
   auto [width, _] = ftxui::Terminal::Size();
   const auto &[path, index, entries] = info;
-  if (entries.empty()) {
+  if (entries.size_ == 0) {
     return window(ftxui::text(" " + path + " ") | ftxui::bold |
                       ftxui::size(ftxui::WIDTH, ftxui::LESS_THAN, width / 2),
                   ftxui::vbox({ftxui::text("[Empty directory]")})) |
@@ -75,6 +76,131 @@ ftxui::Element ContentProvider::left_pane(const MenuInfo &info) {
   return pane;
 }
 
+// One text element per line, the lines are already cut to the pane width
+ftxui::Element ContentProvider::text_lines(const TextLines &lines) {
+  std::vector<ftxui::Element> elements;
+  elements.reserve(lines.size());
+  for (size_t i = 0; i < lines.size(); ++i) {
+    elements.push_back(ftxui::text(std::string{lines.line(i)}));
+  }
+  return ftxui::vbox(std::move(elements));
+}
+
+namespace {
+
+ftxui::Color token_color(TokenKind kind) {
+  switch (kind) {
+  case TokenKind::Keyword:
+    return ColorScheme::keyword();
+  case TokenKind::String:
+    return ColorScheme::string();
+  case TokenKind::Number:
+    return ColorScheme::number();
+  case TokenKind::Comment:
+    return ColorScheme::comment();
+  case TokenKind::Preprocessor:
+    return ColorScheme::preprocessor();
+  case TokenKind::Key:
+    return ColorScheme::key();
+  case TokenKind::Heading:
+    return ColorScheme::heading();
+  case TokenKind::Code:
+    return ColorScheme::code();
+  }
+  return ColorScheme::text();
+}
+
+// Two pixels per cell, the upper one in the foreground of an upper half
+// block and the lower one in its background. Transparent pixels leave the
+// pane's background showing.
+class HalfBlocks : public ftxui::Node {
+private:
+  ImagePtr image_;
+
+  [[nodiscard]] const std::uint8_t *opaque(std::uint32_t x,
+                                           std::uint32_t y) const {
+    if (y >= image_->height_) {
+      return nullptr;
+    }
+    const auto *pixel = image_->pixel(x, y);
+    return pixel[3] >= 0x80 ? pixel : nullptr;
+  }
+
+public:
+  explicit HalfBlocks(ImagePtr image) : image_{std::move(image)} {}
+
+  void ComputeRequirement() override {
+    requirement_.min_x = static_cast<int>(image_->width_);
+    requirement_.min_y = static_cast<int>((image_->height_ + 1) / 2);
+  }
+
+  void Render(ftxui::Screen &screen) override {
+    auto rgb = [](const std::uint8_t *pixel) {
+      return ftxui::Color::RGB(pixel[0], pixel[1], pixel[2]);
+    };
+    auto columns = std::min<std::int64_t>(image_->width_,
+                                          box_.x_max - box_.x_min + 1);
+    auto rows = std::min<std::int64_t>((image_->height_ + 1) / 2,
+                                       box_.y_max - box_.y_min + 1);
+    for (std::uint32_t row = 0; row < rows; ++row) {
+      for (std::uint32_t column = 0; column < columns; ++column) {
+        const auto *upper = opaque(column, row * 2);
+        const auto *lower = opaque(column, (row * 2) + 1);
+        if (upper == nullptr && lower == nullptr) {
+          continue;
+        }
+        auto &cell = screen.PixelAt(box_.x_min + static_cast<int>(column),
+                                    box_.y_min + static_cast<int>(row));
+        if (upper == nullptr) {
+          cell.character = "▄";
+          cell.foreground_color = rgb(lower);
+          continue;
+        }
+        cell.character = "▀";
+        cell.foreground_color = rgb(upper);
+        if (lower != nullptr) {
+          cell.background_color = rgb(lower);
+        }
+      }
+    }
+  }
+};
+
+} // namespace
+
+// One hbox per line, a text element for each token and each gap between
+ftxui::Element
+ContentProvider::highlighted_lines(const HighlightedLines &lines) {
+  const auto &text = lines.lines_->text_;
+  std::vector<ftxui::Element> elements;
+  elements.reserve(lines.lines_->size());
+  for (size_t i = 0; i < lines.lines_->size(); ++i) {
+    std::vector<ftxui::Element> spans;
+    size_t position = lines.lines_->offsets_[i];
+    auto span = [&text](size_t begin, size_t end) {
+      return ftxui::text(text.substr(begin, end - begin));
+    };
+    for (const auto &token : lines.line_tokens(i)) {
+      if (position < token.begin_) {
+        spans.push_back(span(position, token.begin_) |
+                        ftxui::color(ColorScheme::text()));
+      }
+      spans.push_back(span(token.begin_, token.end_) |
+                      ftxui::color(token_color(token.kind_)));
+      position = token.end_;
+    }
+    if (auto end = lines.lines_->offsets_[i + 1]; position < end) {
+      spans.push_back(span(position, end) | ftxui::color(ColorScheme::text()));
+    }
+    elements.push_back(ftxui::hbox(std::move(spans)));
+  }
+  return ftxui::vbox(std::move(elements));
+}
+
+ftxui::Element ContentProvider::image_cells(const ImagePtr &image) {
+  return std::make_shared<HalfBlocks>(image);
+}
+
 ftxui::Element ContentProvider::right_pane(const EntryPreview &preview) {
   auto [width, _] = ftxui::Terminal::Size();
 
@@ -89,6 +215,16 @@ ftxui::Element ContentProvider::right_pane(const EntryPreview &preview) {
                                      return elements |
                                             ftxui::color(ColorScheme::text());
                                    },
+                                   [this](const TextLinesPtr &lines) {
+                                     return text_lines(*lines) |
+                                            ftxui::color(ColorScheme::text());
+                                   },
+                                   [](const HighlightedLinesPtr &lines) {
+                                     return highlighted_lines(*lines);
+                                   },
+                                   [](const ImagePtr &image) {
+                                     return image_cells(image);
+                                   },
                                    [](const std::monostate &state) {
                                      return ftxui::text("No time selected");
                                    }},
@@ -200,6 +336,26 @@ ContentProvider::creation_dialog(int &cursor_position,
   return renderer;
 }
 
+ftxui::Component ContentProvider::jump_dialog(int &cursor_position,
+                                              std::string &offset_input) {
+  ftxui::InputOption option = ftxui::InputOption::Default();
+  option.cursor_position = &cursor_position;
+  option.transform = [this](ftxui::InputState state) -> ftxui::Element {
+    state.element |= color(ColorScheme::text());
+    return state.element;
+  };
+
+  auto input = ftxui::Input(&offset_input, "0x0", option);
+  auto renderer = ftxui::Renderer(input, [this, input] {
+    const auto [width, _] = ftxui::Terminal::Size();
+    return ftxui::window(ftxui::text("Jump to offset"), input->Render()) |
+           ftxui::size(ftxui::WIDTH, ftxui::EQUAL, width / 2) |
+           ftxui::size(ftxui::HEIGHT, ftxui::EQUAL, 3) | ftxui::clear_under;
+  });
+
+  return renderer;
+}
+
 ftxui::Component ContentProvider::notification(std::string &content) {
   return ftxui::Renderer([&, this]() {
     auto [width, _] = ftxui::Terminal::Size();
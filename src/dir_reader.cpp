@@ -0,0 +1,131 @@
+#include "dir_reader.hpp"
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace duck {
+
+namespace {
+
+// Layout of the records returned by getdents64, glibc does not export it.
+struct linux_dirent64 {
+  ino64_t d_ino;
+  off64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+fs::file_type dtype_to_type(unsigned char d_type) {
+  switch (d_type) {
+  case DT_REG:
+    return fs::file_type::regular;
+  case DT_DIR:
+    return fs::file_type::directory;
+  case DT_LNK:
+    return fs::file_type::symlink;
+  case DT_BLK:
+    return fs::file_type::block;
+  case DT_CHR:
+    return fs::file_type::character;
+  case DT_FIFO:
+    return fs::file_type::fifo;
+  case DT_SOCK:
+    return fs::file_type::socket;
+  default:
+    return fs::file_type::unknown;
+  }
+}
+
+fs::file_type stat_type(int dir_fd, const char *name, int flags) {
+  struct stat st{};
+  if (fstatat(dir_fd, name, &st, flags) == -1) {
+    return errno == ENOENT ? fs::file_type::not_found : fs::file_type::unknown;
+  }
+  return mode_to_type(st.st_mode);
+}
+
+} // namespace
+
+fs::file_type mode_to_type(mode_t mode) {
+  switch (mode & S_IFMT) {
+  case S_IFREG:
+    return fs::file_type::regular;
+  case S_IFDIR:
+    return fs::file_type::directory;
+  case S_IFLNK:
+    return fs::file_type::symlink;
+  case S_IFBLK:
+    return fs::file_type::block;
+  case S_IFCHR:
+    return fs::file_type::character;
+  case S_IFIFO:
+    return fs::file_type::fifo;
+  case S_IFSOCK:
+    return fs::file_type::socket;
+  default:
+    return fs::file_type::unknown;
+  }
+}
+
+DirReader::DirReader(const fs::path &path, size_t buffer_size)
+    : fd_{open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)} {
+  if (fd_ == -1) {
+    error_ = std::error_code{errno, std::system_category()};
+    return;
+  }
+  buffer_.resize(buffer_size);
+}
+
+DirReader::~DirReader() {
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+bool DirReader::is_open() const { return fd_ != -1; }
+
+std::error_code DirReader::error() const { return error_; }
+
+bool DirReader::next_batch(std::vector<RawEntry> &batch) {
+  batch.clear();
+  if (fd_ == -1) {
+    return false;
+  }
+
+  auto nread = syscall(SYS_getdents64, fd_, buffer_.data(), buffer_.size());
+  if (nread <= 0) {
+    if (nread == -1) {
+      error_ = std::error_code{errno, std::system_category()};
+    }
+    return false;
+  }
+
+  for (long offset = 0; offset < nread;) {
+    const auto *dirent =
+        reinterpret_cast<const linux_dirent64 *>(buffer_.data() + offset);
+    offset += dirent->d_reclen;
+
+    std::string_view name{dirent->d_name};
+    if (name == "." || name == "..") {
+      continue;
+    }
+
+    RawEntry entry{.name_ = name, .type_ = dtype_to_type(dirent->d_type)};
+    if (dirent->d_type == DT_UNKNOWN) {
+      entry.type_ = stat_type(fd_, dirent->d_name, AT_SYMLINK_NOFOLLOW);
+    }
+    if (entry.type_ == fs::file_type::symlink) {
+      entry.is_symlink_ = true;
+      entry.type_ = stat_type(fd_, dirent->d_name, 0);
+    }
+    batch.push_back(entry);
+  }
+  return true;
+}
+
+} // namespace duck
@@ -0,0 +1,370 @@
+#include "directory_table.hpp"
+#include <algorithm>
+#include <limits>
+#include <tbb/parallel_sort.h>
+
+namespace duck {
+
+namespace {
+
+// fs::file_type::not_found is -1, keep it inside the low nibble
+constexpr std::uint8_t not_found_code = 0x0f;
+constexpr std::uint64_t key_value_mask =
+    std::numeric_limits<std::int64_t>::max();
+
+std::uint8_t encode_type(fs::file_type type) {
+  if (type == fs::file_type::not_found) {
+    return not_found_code;
+  }
+  return static_cast<std::uint8_t>(type);
+}
+
+bool is_digit(char character) { return character >= '0' && character <= '9'; }
+
+struct ExtensionClass {
+  std::string_view extension_;
+  FileClass class_;
+};
+
+constexpr std::array<ExtensionClass, 17> extension_classes{{
+    {".txt", FileClass::Text},     {".md", FileClass::Markdown},
+    {".cpp", FileClass::CppSource}, {".hpp", FileClass::CppHeader},
+    {".h", FileClass::CppHeader},  {".c", FileClass::CSource},
+    {".jpg", FileClass::Image},    {".jpeg", FileClass::Image},
+    {".png", FileClass::Image},    {".gif", FileClass::Gif},
+    {".pdf", FileClass::Pdf},      {".zip", FileClass::Archive},
+    {".mp3", FileClass::Audio},    {".mp4", FileClass::Video},
+    {".json", FileClass::Json},    {".log", FileClass::Log},
+    {".csv", FileClass::Csv},
+}};
+
+bool equals_ignoring_case(std::string_view text, std::string_view lower) {
+  return std::ranges::equal(text, lower, [](char first, char second) {
+    return (first >= 'A' && first <= 'Z' ? first - 'A' + 'a' : first) ==
+           second;
+  });
+}
+
+// The directory bit sorts directories first, the remaining 63 bits hold the
+// mode's value.
+std::uint64_t make_key(std::uint64_t value, bool is_directory) {
+  auto file_bit = static_cast<std::uint64_t>(!is_directory) << 63U;
+  return file_bit | (value & key_value_mask);
+}
+
+// First eight bytes in big-endian order so that integer order matches byte
+// order, shifted to fit next to the directory bit.
+std::uint64_t prefix_value(std::string_view bytes) {
+  std::uint64_t prefix = 0;
+  for (size_t i = 0; i < sizeof(prefix); ++i) {
+    prefix <<= 8U;
+    if (i < bytes.size()) {
+      prefix |= static_cast<unsigned char>(bytes[i]);
+    }
+  }
+  return prefix >> 1U;
+}
+
+// Bytes up to the first digit, which becomes a single '0'. No other byte
+// falls between the digits, so this prefix orders like natural_compare().
+std::uint64_t natural_prefix_value(std::string_view name) {
+  std::array<char, sizeof(std::uint64_t)> prefix{};
+  size_t size = 0;
+  for (auto character : name) {
+    if (size == prefix.size()) {
+      break;
+    }
+    if (is_digit(character)) {
+      prefix[size++] = '0';
+      break;
+    }
+    prefix[size++] = character;
+  }
+  return prefix_value({prefix.data(), size});
+}
+
+// Orders digit runs by their numeric value, so file2 < file10, and every
+// other byte by its value.
+int natural_compare(std::string_view first, std::string_view second) {
+  size_t i = 0;
+  size_t j = 0;
+  while (i < first.size() && j < second.size()) {
+    if (is_digit(first[i]) && is_digit(second[j])) {
+      while (i < first.size() && first[i] == '0') {
+        ++i;
+      }
+      while (j < second.size() && second[j] == '0') {
+        ++j;
+      }
+      auto first_end = i;
+      auto second_end = j;
+      while (first_end < first.size() && is_digit(first[first_end])) {
+        ++first_end;
+      }
+      while (second_end < second.size() && is_digit(second[second_end])) {
+        ++second_end;
+      }
+      if (first_end - i != second_end - j) {
+        return first_end - i < second_end - j ? -1 : 1;
+      }
+      if (auto digits = first.substr(i, first_end - i).compare(
+              second.substr(j, second_end - j));
+          digits != 0) {
+        return digits;
+      }
+      i = first_end;
+      j = second_end;
+      continue;
+    }
+
+    if (first[i] != second[j]) {
+      return static_cast<unsigned char>(first[i]) <
+                     static_cast<unsigned char>(second[j])
+                 ? -1
+                 : 1;
+    }
+    ++i;
+    ++j;
+  }
+
+  if (first.size() - i != second.size() - j) {
+    return first.size() - i < second.size() - j ? -1 : 1;
+  }
+  return first.compare(second);
+}
+
+struct SortKey {
+  std::uint64_t key_;
+  Row row_;
+};
+
+} // namespace
+
+FileClass classify(std::string_view name, fs::file_type type) {
+  if (type == fs::file_type::none || type == fs::file_type::not_found) {
+    return FileClass::Missing;
+  }
+  if (type == fs::file_type::directory) {
+    return FileClass::Directory;
+  }
+  auto extension = name_extension(name);
+  auto it = std::ranges::find_if(
+      extension_classes, [extension](const ExtensionClass &candidate) {
+        return equals_ignoring_case(extension, candidate.extension_);
+      });
+  return it != extension_classes.end() ? it->class_ : FileClass::Other;
+}
+
+Row DirectoryTable::append(std::string_view name, fs::file_type type,
+                           bool is_symlink) {
+  auto row = static_cast<Row>(kinds_.size());
+  names_.append(name);
+  name_offsets_.push_back(static_cast<std::uint32_t>(names_.size()));
+
+  auto kind = encode_type(type);
+  if (name.starts_with('.')) {
+    kind |= hidden_flag;
+  }
+  if (is_symlink) {
+    kind |= symlink_flag;
+  }
+  kinds_.push_back(kind);
+  classes_.push_back(classify(name, type));
+
+  if (has_metadata()) {
+    sizes_.push_back(0);
+    mtimes_.push_back(0);
+  }
+
+  for (size_t mode = 0; mode < sort_mode_count; ++mode) {
+    if (has_keys(static_cast<SortMode>(mode))) {
+      sort_keys_[mode].push_back(compute_key(row, static_cast<SortMode>(mode)));
+    }
+  }
+  return row;
+}
+
+void DirectoryTable::reserve(size_t rows, size_t name_bytes) {
+  names_.reserve(name_bytes);
+  name_offsets_.reserve(rows + 1);
+  kinds_.reserve(rows);
+  classes_.reserve(rows);
+  sort_keys_[static_cast<size_t>(SortMode::Name)].reserve(rows);
+}
+
+fs::file_type DirectoryTable::type(Row row) const {
+  auto code = static_cast<std::uint8_t>(kinds_[row] & type_mask);
+  if (code == not_found_code) {
+    return fs::file_type::not_found;
+  }
+  return static_cast<fs::file_type>(code);
+}
+
+void DirectoryTable::set_metadata(Row row, std::uint64_t size_bytes,
+                                  std::int64_t mtime_ns) {
+  if (!has_metadata()) {
+    sizes_.resize(size());
+    mtimes_.resize(size());
+  }
+  sizes_[row] = size_bytes;
+  mtimes_[row] = mtime_ns;
+
+  for (auto mode : {SortMode::Size, SortMode::Mtime}) {
+    if (has_keys(mode)) {
+      sort_keys_[static_cast<size_t>(mode)][row] = compute_key(row, mode);
+    }
+  }
+}
+
+std::uint64_t DirectoryTable::compute_key(Row row, SortMode mode) const {
+  auto is_dir = is_directory(row);
+  switch (mode) {
+  case SortMode::Name:
+    return make_key(prefix_value(name(row)), is_dir);
+  case SortMode::Size:
+    // directories have no meaningful size and keep their name order
+    return make_key(has_metadata() && !is_dir ? sizes_[row] : 0, is_dir);
+  case SortMode::Mtime: {
+    // newest first
+    auto mtime = has_metadata() ? std::max<std::int64_t>(mtimes_[row], 0) : 0;
+    return make_key(key_value_mask - static_cast<std::uint64_t>(mtime),
+                    is_dir);
+  }
+  case SortMode::Extension:
+    return make_key(prefix_value(name_extension(name(row))), is_dir);
+  case SortMode::Natural:
+    return make_key(natural_prefix_value(name(row)), is_dir);
+  }
+  return make_key(0, is_dir);
+}
+
+bool DirectoryTable::tie_less(Row first, Row second, SortMode mode) const {
+  switch (mode) {
+  case SortMode::Extension: {
+    auto first_ext = name_extension(name(first));
+    auto second_ext = name_extension(name(second));
+    if (first_ext != second_ext) {
+      return first_ext < second_ext;
+    }
+    break;
+  }
+  case SortMode::Natural:
+    return natural_compare(name(first), name(second)) < 0;
+  default:
+    break;
+  }
+  return name(first) < name(second);
+}
+
+void DirectoryTable::ensure_keys(SortMode mode) {
+  if (has_keys(mode)) {
+    return;
+  }
+  auto &keys = sort_keys_[static_cast<size_t>(mode)];
+  keys.resize(size());
+  for (Row row = 0; row < size(); ++row) {
+    keys[row] = compute_key(row, mode);
+  }
+  key_modes_ |= 1U << static_cast<unsigned>(mode);
+}
+
+void DirectoryTable::sort(std::span<Row> rows, SortMode mode) const {
+  const auto &mode_keys = sort_keys_[static_cast<size_t>(mode)];
+  std::vector<SortKey> keys;
+  keys.reserve(rows.size());
+  for (auto row : rows) {
+    keys.push_back({.key_ = mode_keys[row], .row_ = row});
+  }
+
+  auto key_less = [this, mode](const SortKey &first, const SortKey &second) {
+    if (first.key_ != second.key_) {
+      return first.key_ < second.key_;
+    }
+    return tie_less(first.row_, second.row_, mode);
+  };
+  if (keys.size() >= parallel_sort_threshold) {
+    tbb::parallel_sort(keys.begin(), keys.end(), key_less);
+  } else {
+    std::ranges::sort(keys, key_less);
+  }
+
+  std::ranges::transform(keys, rows.begin(), &SortKey::row_);
+}
+
+void DirectoryTable::insert_sorted(std::vector<Row> &rows, Row row,
+                                   SortMode mode) const {
+  auto it = std::ranges::upper_bound(rows, row,
+                                     [this, mode](Row first, Row second) {
+                                       return less(first, second, mode);
+                                     });
+  rows.insert(it, row);
+}
+
+std::optional<DirectoryTable> DirectoryTable::from_columns(
+    std::string names, std::vector<std::uint32_t> name_offsets,
+    std::vector<std::uint8_t> kinds, std::vector<std::uint64_t> sizes,
+    std::vector<std::int64_t> mtimes) {
+  auto rows = kinds.size();
+  if (name_offsets.size() != rows + 1 || name_offsets.front() != 0 ||
+      name_offsets.back() != names.size() ||
+      !std::ranges::is_sorted(name_offsets) || sizes.size() != mtimes.size() ||
+      (!sizes.empty() && sizes.size() != rows)) {
+    return std::nullopt;
+  }
+
+  DirectoryTable table;
+  table.names_ = std::move(names);
+  table.name_offsets_ = std::move(name_offsets);
+  table.kinds_ = std::move(kinds);
+  table.sizes_ = std::move(sizes);
+  table.mtimes_ = std::move(mtimes);
+  table.classes_.reserve(rows);
+  for (Row row = 0; row < rows; ++row) {
+    table.classes_.push_back(classify(table.name(row), table.type(row)));
+  }
+  table.key_modes_ = 0;
+  table.ensure_keys(SortMode::Name);
+  return table;
+}
+
+DirectoryTable DirectoryTable::select(std::span<const Row> rows) const {
+  DirectoryTable table;
+  size_t name_bytes = 0;
+  for (auto row : rows) {
+    name_bytes += name(row).size();
+  }
+  table.reserve(rows.size(), name_bytes);
+  table.key_modes_ = key_modes_;
+  for (auto row : rows) {
+    table.names_.append(name(row));
+    table.name_offsets_.push_back(static_cast<std::uint32_t>(
+        table.names_.size()));
+    table.kinds_.push_back(kinds_[row]);
+    table.classes_.push_back(classes_[row]);
+    if (has_metadata()) {
+      table.sizes_.push_back(sizes_[row]);
+      table.mtimes_.push_back(mtimes_[row]);
+    }
+    for (size_t mode = 0; mode < sort_mode_count; ++mode) {
+      if (has_keys(static_cast<SortMode>(mode))) {
+        table.sort_keys_[mode].push_back(sort_keys_[mode][row]);
+      }
+    }
+  }
+  return table;
+}
+
+size_t DirectoryTable::memory_bytes() const {
+  auto bytes = sizeof(*this) + names_.capacity() +
+               name_offsets_.capacity() * sizeof(std::uint32_t) +
+               kinds_.capacity() * sizeof(std::uint8_t) +
+               classes_.capacity() * sizeof(FileClass) +
+               sizes_.capacity() * sizeof(std::uint64_t) +
+               mtimes_.capacity() * sizeof(std::int64_t);
+  for (const auto &keys : sort_keys_) {
+    bytes += keys.capacity() * sizeof(std::uint64_t);
+  }
+  return bytes;
+}
+
+} // namespace duck
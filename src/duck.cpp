@@ -3,12 +3,39 @@
 #include "event_bus.hpp"
 #include "input_handler.hpp"
 #include "ui.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <print>
 
 namespace duck {
 Duck::Duck()
     : input_handler_{event_bus_}, ui_{input_handler_},
-      file_manager_{event_bus_}, app_{event_bus_, ui_, file_manager_} {}
+      file_manager_{event_bus_}, watcher_{event_bus_}, prefetcher_{event_bus_},
+      app_{event_bus_, ui_, file_manager_, watcher_, prefetcher_} {}
 
-void Duck::run() { app_.run(); }
+void Duck::run() {
+  app_.run();
+
+  if (std::getenv("DUCK_STATS") != nullptr) {
+    std::println(
+        stderr, "startup: {:.2f} ms ({})",
+        std::chrono::duration<double, std::milli>(app_.startup_time()).count(),
+        app_.restored_from_snapshot() ? "snapshot" : "cold");
+    auto cache = app_.cache_stats();
+    std::println(stderr, "cache: {:.1f} MiB of {:.1f} MiB, shed {} times",
+                 static_cast<double>(cache.bytes_) / (1 << 20),
+                 static_cast<double>(cache.budget_) / (1 << 20), cache.sheds_);
+    auto revalidation = app_.revalidation_stats();
+    std::println(stderr,
+                 "revalidation: checked {} stale {} rate limited {}",
+                 revalidation.revalidations_, revalidation.stale_hits_,
+                 revalidation.rate_limited_);
+    auto prefetch = prefetcher_.stats();
+    std::println(stderr,
+                 "prefetch: issued {} loaded {} cancelled {} hits {} misses {}",
+                 prefetch.issued_, prefetch.loaded_, prefetch.cancelled_,
+                 prefetch.hits_, prefetch.misses_);
+  }
+}
 
 } // namespace duck
@@ -55,6 +55,18 @@ std::optional<AppEvent> EventBus::try_pop_event() {
   return event_pair;
 }
 
+std::optional<AppEvent> EventBus::try_pop_event_if(
+    const std::function<bool(const AppEvent &)> &pred) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (event_queue_.empty() || !pred(event_queue_.front())) {
+    return std::nullopt;
+  }
+
+  auto event_pair = std::move(event_queue_.front());
+  event_queue_.pop();
+  return event_pair;
+}
+
 bool EventBus::empty() const {
   std::lock_guard<std::mutex> lock(mutex_);
   return event_queue_.empty();
@@ -1,13 +1,23 @@
 #include "file_manager.hpp"
+#include "archive_lister.hpp"
 #include "app_event.hpp"
+#include "dir_reader.hpp"
+#include "hex_dump.hpp"
+#include "preview_reader.hpp"
 #include "scheduler.hpp"
 #include "utils.hpp"
-#include <array>
-#include <cstring>
+#include <algorithm>
+#include <cstdint>
+#include <fcntl.h>
 #include <filesystem>
 #include <fstream>
+#include <limits>
+#include <memory>
 #include <ftxui/dom/elements.hpp>
 #include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
 #include <vector>
 
 namespace duck {
@@ -16,97 +26,425 @@ using std::string;
 namespace fs = std::filesystem;
 
 constexpr size_t dirs_reserve = 256;
+constexpr size_t first_chunk_size = 256;
+
+namespace {
+
+// Calls `on_batch` with every batch of entries DirReader returns for `path`,
+// until it returns false.
+template <typename Fn> void read_entries(const fs::path &path, Fn &&on_batch) {
+  DirReader reader{path};
+  if (!reader.is_open()) {
+    if (reader.error() == std::errc::permission_denied) {
+      return;
+    }
+    throw fs::filesystem_error("load_directory", path, reader.error());
+  }
+
+  std::vector<RawEntry> batch;
+  while (reader.next_batch(batch)) {
+    if (!on_batch(std::as_const(batch))) {
+      return;
+    }
+  }
+}
+
+} // namespace
 
 FileManager::FileManager(EventBus &event_bus) : event_bus_(event_bus) {}
 
-Directory FileManager::load_directory(const fs::path &path) {
-  Directory directory{.path_ = path};
+Directory FileManager::load_directory(const fs::path &path, SortMode mode) {
+  // Stamped before reading so that changes made during the read show up
+  Directory directory{.path_ = path, .stamp_ = stamp_directory(path)};
   directory.entries_.reserve(dirs_reserve);
-  directory.hidden_entries_.reserve(dirs_reserve);
 
-  for (auto entry : fs::directory_iterator(
-           path, fs::directory_options::skip_permission_denied)) {
-    if (entry.path().empty()) {
-      continue;
+  read_entries(path, [&directory](const std::vector<RawEntry> &batch) {
+    for (const auto &raw : batch) {
+      directory.add_entry(raw.name_, raw.type_, raw.is_symlink_);
+    }
+    return true;
+  });
+
+  if (needs_metadata(mode)) {
+    load_metadata(directory);
+  }
+  directory.set_sort_mode(mode);
+  return directory;
+}
+
+std::optional<Directory>
+FileManager::load_directory_bounded(const fs::path &path, SortMode mode,
+                                    size_t max_entries,
+                                    const std::function<bool()> &cancelled) {
+  DirReader reader{path};
+  if (!reader.is_open()) {
+    return std::nullopt;
+  }
+
+  Directory directory{.path_ = path, .stamp_ = stamp_directory(path)};
+  std::vector<RawEntry> batch;
+  while (reader.next_batch(batch)) {
+    if (cancelled() || directory.table_.size() + batch.size() > max_entries) {
+      return std::nullopt;
     }
-    if (entry.path().filename().native()[0] == '.') {
-      directory.hidden_entries_.push_back(std::move(entry));
-    } else {
-      directory.entries_.push_back(std::move(entry));
+    for (const auto &raw : batch) {
+      directory.add_entry(raw.name_, raw.type_, raw.is_symlink_);
     }
   }
 
-  std::ranges::sort(directory.entries_, entries_sorter);
-  std::ranges::sort(directory.hidden_entries_, entries_sorter);
+  if (needs_metadata(mode)) {
+    if (cancelled()) {
+      return std::nullopt;
+    }
+    load_metadata(directory);
+  }
+  directory.set_sort_mode(mode);
   return directory;
 }
 
-void FileManager::async_load_directory(const fs::path &path) {
+void FileManager::load_metadata(Directory &directory) {
+  auto dir_fd =
+      open(directory.path_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd == -1) {
+    return;
+  }
+
+  auto &table = directory.table_;
+  std::string name;
+  for (Row row = 0; row < table.size(); ++row) {
+    name = table.name(row);
+    struct stat st{};
+    if (fstatat(dir_fd, name.c_str(), &st, 0) == -1 &&
+        fstatat(dir_fd, name.c_str(), &st, AT_SYMLINK_NOFOLLOW) == -1) {
+      continue;
+    }
+    table.set_metadata(row, static_cast<std::uint64_t>(st.st_size),
+                       st.st_mtim.tv_sec * 1'000'000'000 + st.st_mtim.tv_nsec);
+  }
+  close(dir_fd);
+}
+
+void FileManager::set_sort_mode(SortMode mode) { sort_mode_ = mode; }
+
+void FileManager::async_sort_directory(Directory directory, SortMode mode) {
   auto task = stdexec::schedule(Scheduler::io_scheduler()) |
-              stdexec::then([path]() { return load_directory(path); }) |
-              stdexec::then([this](const Directory &directory) {
-                event_bus_.push_event(DirecotryLoaded{.update_preview_ = false,
-                                                      .directory_ = directory});
+              stdexec::then([this, directory = std::move(directory),
+                             mode]() mutable {
+                load_metadata(directory);
+                directory.set_sort_mode(mode);
+                event_bus_.push_event(DirecotryLoaded{
+                    .keep_focus_ = true, .directory_ = std::move(directory)});
               });
   scope_.spawn(std::move(task));
 }
 
-void FileManager::async_update_preview(const fs::directory_entry &entry,
-                                       const std::pair<int, int> &size) {
+void FileManager::async_load_directory(const fs::path &path) {
   auto task =
       stdexec::schedule(Scheduler::io_scheduler()) |
-      stdexec::then([this, entry, size]() -> std::optional<std::string> {
-        if (entry.is_directory()) {
-          event_bus_.push_event(DirecotryLoaded{
-              .update_preview_ = true, .directory_ = load_directory(entry)});
-          return std::nullopt;
+      stdexec::then([this, path, mode = sort_mode_]() {
+        // The directory may be gone by now, keep what is cached then
+        auto directory = load_directory_bounded(
+            path, mode, std::numeric_limits<size_t>::max(),
+            []() { return false; });
+        if (directory) {
+          event_bus_.push_event(
+              DirecotryLoaded{.update_preview_ = false,
+                              .keep_focus_ = true,
+                              .directory_ = std::move(directory.value())});
         }
+      });
+  scope_.spawn(std::move(task));
+}
 
-        std::ifstream file(entry.path(), std::ios::binary);
-        if (!file.is_open()) {
-          return "[Can't open file]";
+void FileManager::async_revalidate(
+    std::vector<std::pair<fs::path, DirectoryStamp>> stamps) {
+  auto task =
+      stdexec::schedule(Scheduler::background_scheduler()) |
+      stdexec::then([this, stamps = std::move(stamps), mode = sort_mode_]() {
+        auto never = []() { return false; };
+        for (const auto &[path, stamp] : stamps) {
+          if (stamp_directory(path) == stamp) {
+            continue;
+          }
+          auto directory = load_directory_bounded(
+              path, mode, std::numeric_limits<size_t>::max(), never);
+          if (directory) {
+            event_bus_.push_event(
+                DirecotryLoaded{.keep_focus_ = true,
+                                .directory_ = std::move(directory.value())});
+          }
         }
+      });
+  scope_.spawn(std::move(task));
+}
+
+std::optional<EntryPreview>
+FileManager::file_preview(const fs::path &path, ContentType type,
+                          const std::pair<int, int> &size,
+                          std::uint64_t offset,
+                          const stdexec::inplace_stop_token &token) {
+  if (type == ContentType::Unreadable || token.stop_requested()) {
+    return std::nullopt;
+  }
+  if (type == ContentType::Empty) {
+    return "[Empty file]";
+  }
+
+  auto [width, height] = size;
+  auto columns = static_cast<size_t>(std::max(width, 0));
+  auto rows = static_cast<size_t>(std::max(height, 0));
+  if (is_archive(type)) {
+    auto stopped = [&token]() { return token.stop_requested(); };
+    if (auto listing = list_archive(path, type, rows, stopped)) {
+      return std::make_shared<const TextLines>(
+          archive_lines(listing.value(), columns, rows));
+    }
+    // Broken, or gzip around something else: shown as bytes below
+    if (token.stop_requested()) {
+      return std::nullopt;
+    }
+  }
+  // Everything else is shown as bytes, from `offset` on
+  auto lines = type == ContentType::Text
+                   ? read_preview(path, columns, rows)
+                   : read_hex(path, offset, columns, rows);
+  if (!lines) {
+    return std::nullopt;
+  }
+  if (lines.value().empty()) {
+    return "[Empty file]";
+  }
+  return std::make_shared<const TextLines>(std::move(lines.value()));
+}
+
+std::optional<EntryPreview>
+FileManager::cached_preview(const Entry &entry,
+                            const std::pair<int, int> &size,
+                            std::uint64_t offset) {
+  if (entry.is_directory()) {
+    return std::nullopt;
+  }
+  auto identity = identify_path(entry.path());
+  if (!identity) {
+    return std::nullopt;
+  }
+  return previews_.get({identity.value(), size, offset});
+}
+
+void FileManager::cancel_preview() {
+  if (preview_stop_) {
+    preview_stop_->request_stop();
+    preview_stop_.reset();
+  }
+  ++preview_epoch_;
+}
 
-        auto mime = get_mime(entry.path());
-        if (!mime.starts_with("text/") &&
-            !mime.starts_with("application/json")) {
-          return "[Binary file]";
+Epoch FileManager::preview_epoch() const { return preview_epoch_; }
+
+void FileManager::cancel_enter() {
+  if (enter_stop_) {
+    enter_stop_->request_stop();
+    enter_stop_.reset();
+  }
+  ++enter_epoch_;
+}
+
+Epoch FileManager::enter_epoch() const { return enter_epoch_; }
+
+void FileManager::async_update_preview(const Entry &entry,
+                                       const std::pair<int, int> &size,
+                                       std::uint64_t offset) {
+  cancel_preview();
+  preview_stop_ = std::make_shared<stdexec::inplace_stop_source>();
+  // `stop` keeps the source of `token` alive until the task is done
+  auto task =
+      stdexec::schedule(Scheduler::io_scheduler()) |
+      stdexec::then([this, entry, size, offset, mode = sort_mode_,
+                     epoch = preview_epoch_, stop = preview_stop_,
+                     token = preview_stop_->get_token()]()
+                        -> std::optional<EntryPreview> {
+        // Held j through a directory: everything queued behind the latest
+        // request ends here without touching the disk
+        if (token.stop_requested()) {
+          return std::nullopt;
         }
 
-        auto [width, height] = size;
-        std::string content;
-        std::string line;
-        for (int i = 0; i < height && std::getline(file, line); ++i) {
-          if (line.size() > width) {
-            line = line.substr(0, width) + "...";
+        if (entry.is_directory()) {
+          auto stopped = [&token]() { return token.stop_requested(); };
+          auto directory = load_directory_bounded(
+              entry.path(), mode, std::numeric_limits<size_t>::max(),
+              stopped);
+          if (stopped()) {
+            return std::nullopt;
           }
-          content += line + '\n';
+          // Unreadable, shown as empty
+          if (!directory) {
+            directory = Directory{.path_ = entry.path(),
+                                  .stamp_ = stamp_directory(entry.path())};
+          }
+          event_bus_.push_event(
+              DirecotryLoaded{.update_preview_ = true,
+                              .epoch_ = epoch,
+                              .directory_ = std::move(directory.value())});
+          return std::nullopt;
         }
 
-        if (file.eof() && content.empty() && line.empty()) {
-          return "[Empty file]";
+        // Identified before reading, so a change while reading leaves the
+        // cached preview under an identity the file no longer has
+        auto identity = identify_path(entry.path());
+        std::optional<PreviewKey> key;
+        if (identity) {
+          key = PreviewKey{identity.value(), size, offset};
         }
-
-        return content;
+        auto type = sniffer_.sniff(entry.path());
+        if (is_image(type) && !token.stop_requested()) {
+          event_bus_.push_event(TextPreview{
+              .preview_ = "[" + std::string{content_mime(type)} + "]",
+              .epoch_ = epoch});
+          async_decode_image(entry.path(), type, size, key, epoch, stop);
+          return std::nullopt;
+        }
+        auto preview = file_preview(entry.path(), type, size, offset, token);
+        if (token.stop_requested()) {
+          return std::nullopt;
+        }
+        if (!preview) {
+          return "[Can't open file]";
+        }
+        const auto *lines = std::get_if<TextLinesPtr>(&preview.value());
+        if (lines != nullptr && type == ContentType::Text) {
+          auto language = detect_language(entry.path(), (*lines)->line(0));
+          if (language != Language::Plain) {
+            // Shown right away: the CPU pool may be busy decoding an image
+            event_bus_.push_event(
+                TextPreview{.preview_ = *lines, .epoch_ = epoch});
+            async_highlight(*lines, language, key, epoch, stop);
+            return std::nullopt;
+          }
+        }
+        if (key) {
+          previews_.insert(key.value(), preview.value());
+        }
+        return preview;
       }) |
-      stdexec::then([this](const std::optional<std::string> &preview) {
+      stdexec::then([this, epoch = preview_epoch_](
+                        const std::optional<EntryPreview> &preview) {
         if (preview) {
-          event_bus_.push_event(TextPreview{preview.value()});
+          event_bus_.push_event(
+              TextPreview{.preview_ = preview.value(), .epoch_ = epoch});
         }
       });
   scope_.spawn(task);
 }
 
+void FileManager::async_highlight(
+    TextLinesPtr lines, Language language, std::optional<PreviewKey> key,
+    Epoch epoch, std::shared_ptr<stdexec::inplace_stop_source> stop) {
+  auto task =
+      stdexec::schedule(Scheduler::cpu_scheduler()) |
+      stdexec::then([this, lines = std::move(lines), language, key, epoch,
+                     stop = std::move(stop)]() {
+        auto token = stop->get_token();
+        auto stopped = [&token]() { return token.stop_requested(); };
+        auto highlighted = highlight(lines, language, stopped);
+        if (!highlighted) {
+          return;
+        }
+        EntryPreview preview = std::make_shared<const HighlightedLines>(
+            std::move(highlighted.value()));
+        if (key) {
+          previews_.insert(key.value(), preview);
+        }
+        event_bus_.push_event(
+            TextPreview{.preview_ = std::move(preview), .epoch_ = epoch});
+      });
+  scope_.spawn(std::move(task));
+}
+
+void FileManager::async_decode_image(
+    const fs::path &path, ContentType type, const std::pair<int, int> &size,
+    std::optional<PreviewKey> key, Epoch epoch,
+    std::shared_ptr<stdexec::inplace_stop_source> stop) {
+  auto task =
+      stdexec::schedule(Scheduler::cpu_scheduler()) |
+      stdexec::then([this, path, type, size, key, epoch,
+                     stop = std::move(stop)]() {
+        auto token = stop->get_token();
+        auto stopped = [&token]() { return token.stop_requested(); };
+        // A cell shows two pixels, one above the other
+        auto [width, height] = size;
+        auto box_width = static_cast<std::uint32_t>(std::max(width, 0));
+        auto box_height = static_cast<std::uint32_t>(std::max(height, 0)) * 2;
+        auto image = decode_image(path, type, box_width, box_height, stopped);
+        if (stopped()) {
+          return;
+        }
+        // Broken images are cached as their label, so they aren't decoded
+        // again each time the cursor passes
+        EntryPreview preview = "[" + std::string{content_mime(type)} + "]";
+        if (image) {
+          preview = std::make_shared<const Image>(std::move(image.value()));
+        }
+        if (key) {
+          previews_.insert(key.value(), preview);
+        }
+        if (image) {
+          event_bus_.push_event(
+              TextPreview{.preview_ = std::move(preview), .epoch_ = epoch});
+        }
+      });
+  scope_.spawn(std::move(task));
+}
+
 void FileManager::async_enter_directory(const fs::path &path) {
+  cancel_enter();
+  enter_stop_ = std::make_shared<stdexec::inplace_stop_source>();
   auto task =
       stdexec::schedule(Scheduler::io_scheduler()) |
-      stdexec::then([this, path]() {
-        event_bus_.push_event(DirecotryLoaded{
-            .update_preview_ = false, .directory_ = load_directory(path)});
-      }) |
-      stdexec::then([this, path]() {
-        event_bus_.push_event(FmgrEvent{
-            .type_ = FmgrEvent::Type::UpdateCurrentDirectory, .path = path});
+      stdexec::then([this, path, mode = sort_mode_, epoch = enter_epoch_,
+                     stop = enter_stop_]() {
+        auto token = stop->get_token();
+        if (token.stop_requested()) {
+          return;
+        }
+        Directory directory{.path_ = path, .stamp_ = stamp_directory(path)};
+        DirectoryTable chunk;
+        auto chunk_size = first_chunk_size;
+
+        // Stream unsorted chunks, the first one sized to fill the screen and
+        // every following one twice as large as the previous.
+        read_entries(path, [&](const std::vector<RawEntry> &batch) {
+          if (token.stop_requested()) {
+            return false;
+          }
+          for (const auto &raw : batch) {
+            directory.add_entry(raw.name_, raw.type_, raw.is_symlink_);
+            chunk.append(raw.name_, raw.type_, raw.is_symlink_);
+            if (chunk.size() == chunk_size) {
+              event_bus_.push_event(DirectoryChunk{.path_ = path,
+                                                   .table_ = std::move(chunk),
+                                                   .epoch_ = epoch});
+              chunk = DirectoryTable{};
+              chunk_size *= 2;
+            }
+          }
+          return true;
+        });
+        // The chunks already shown stay marked partial until a reload
+        if (token.stop_requested()) {
+          return;
+        }
+
+        if (needs_metadata(mode)) {
+          load_metadata(directory);
+        }
+        directory.set_sort_mode(mode);
+
+        // Enters the directory unless a chunk already did
+        event_bus_.push_event(DirecotryLoaded{.keep_focus_ = true,
+                                              .epoch_ = epoch,
+                                              .directory_ =
+                                                  std::move(directory)});
       });
   scope_.spawn(task);
 }
@@ -135,9 +473,11 @@ void FileManager::async_create_entry(const fs::path &path, bool is_directory) {
                   ofs.close();
                 }
               }) |
-              stdexec::then([this, path]() {
-                event_bus_.push_event(FmgrEvent{
-                    .type_ = FmgrEvent::Type::CreationSuccess, .path = path});
+              stdexec::then([this, path, is_directory]() {
+                event_bus_.push_event(
+                    FmgrEvent{.type_ = FmgrEvent::Type::CreationSuccess,
+                              .path = path,
+                              .is_directory = is_directory});
               });
   scope_.spawn(std::move(task));
 }
@@ -184,32 +524,14 @@ void FileManager::async_paste_entries(const fs::path &dest,
           }
         }
       }) |
-      stdexec::then([this, dest]() {
-        event_bus_.push_event(DirecotryLoaded{
-            .update_preview_ = false, .directory_ = load_directory(dest)});
+      stdexec::then([this, dest, mode = sort_mode_]() {
+        event_bus_.push_event(
+            DirecotryLoaded{.update_preview_ = false,
+                            .directory_ = load_directory(dest, mode)});
         event_bus_.push_event(FmgrEvent{
             .type_ = FmgrEvent::Type::UpdateCurrentDirectory, .path = dest});
       });
   scope_.spawn(std::move(task));
 }
 
-std::string FileManager::get_mime(const std::filesystem::path &path) {
-  constexpr int buffer_size = 256;
-  std::array<char, buffer_size> buffer{};
-  std::string cmd = "file -b --mime-type " + path.string();
-
-  using file_closer_t = int (*)(FILE *);
-  std::unique_ptr<FILE, file_closer_t> pipe(popen(cmd.c_str(), "r"), pclose);
-
-  if (!pipe) {
-    return {"Unknow"};
-  }
-
-  if (fgets(buffer.data(), buffer.size(), pipe.get()) == nullptr) {
-    throw std::runtime_error("fgets() failed");
-  }
-
-  return {buffer.data()};
-}
-
 } // namespace duck
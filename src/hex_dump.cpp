@@ -0,0 +1,191 @@
+#include "hex_dump.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace duck {
+
+namespace {
+
+constexpr std::string_view hex_digits = "0123456789abcdef";
+// Offsets take at least this many digits
+constexpr size_t offset_digits = 8;
+// An extra space splits the hex of a row into groups of this many bytes
+constexpr size_t hex_group_size = 8;
+
+// `bytes` with everything but printable ASCII replaced by '.'
+void printable_or_dot(std::span<const std::uint8_t> bytes, char *out) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 16 <= bytes.size(); i += 16) {
+    auto block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes.data() + i));
+    // Signed compare: bytes from 0x80 up are below 0x20 here too
+    auto rejected = _mm_or_si128(_mm_cmplt_epi8(block, _mm_set1_epi8(0x20)),
+                                 _mm_cmpeq_epi8(block, _mm_set1_epi8(0x7f)));
+    auto shown = _mm_or_si128(_mm_andnot_si128(rejected, block),
+                              _mm_and_si128(rejected, _mm_set1_epi8('.')));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), shown);
+  }
+#endif
+  for (; i < bytes.size(); ++i) {
+    auto byte = bytes[i];
+    out[i] = byte >= 0x20 && byte < 0x7f ? static_cast<char>(byte) : '.';
+  }
+}
+
+size_t row_width(size_t row_size) {
+  auto groups = (row_size + hex_group_size - 1) / hex_group_size;
+  return offset_digits + 2 + (row_size * 3) + groups + row_size + 2;
+}
+
+} // namespace
+
+void encode_hex(std::span<const std::uint8_t> bytes, char *out) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  auto low_nibbles = _mm_set1_epi8(0x0f);
+  // Nibbles above 9 skip the punctuation between '9' and 'a'
+  auto to_ascii = [](__m128i nibbles) {
+    auto letters = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+    return _mm_add_epi8(
+        _mm_add_epi8(nibbles, _mm_set1_epi8('0')),
+        _mm_and_si128(letters, _mm_set1_epi8('a' - '0' - 10)));
+  };
+  for (; i + 16 <= bytes.size(); i += 16) {
+    auto block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes.data() + i));
+    auto high = to_ascii(_mm_and_si128(_mm_srli_epi16(block, 4), low_nibbles));
+    auto low = to_ascii(_mm_and_si128(block, low_nibbles));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + (i * 2)),
+                     _mm_unpacklo_epi8(high, low));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + (i * 2) + 16),
+                     _mm_unpackhi_epi8(high, low));
+  }
+#endif
+  for (; i < bytes.size(); ++i) {
+    out[i * 2] = hex_digits[bytes[i] >> 4U];
+    out[(i * 2) + 1] = hex_digits[bytes[i] & 0x0fU];
+  }
+}
+
+size_t hex_row_size(size_t columns) {
+  for (size_t row_size = hex_row_bytes; row_size > 4; row_size /= 2) {
+    if (row_width(row_size) <= columns) {
+      return row_size;
+    }
+  }
+  return 4;
+}
+
+TextLines hex_lines(std::span<const std::uint8_t> bytes, std::uint64_t offset,
+                    size_t row_size) {
+  row_size = std::clamp<size_t>(row_size, 1, hex_row_bytes);
+  auto last = offset + bytes.size();
+  auto digits = std::max<size_t>(
+      offset_digits, static_cast<size_t>(std::bit_width(last) + 3) / 4);
+
+  TextLines lines;
+  auto rows = (bytes.size() + row_size - 1) / row_size;
+  lines.text_.reserve(rows * (row_width(row_size) + digits - offset_digits));
+  lines.offsets_.reserve(rows + 1);
+  std::array<char, hex_row_bytes * 2> hex{};
+  std::array<char, hex_row_bytes> ascii{};
+  for (size_t start = 0; start < bytes.size(); start += row_size) {
+    auto row = bytes.subspan(start, std::min(row_size, bytes.size() - start));
+    encode_hex(row, hex.data());
+    printable_or_dot(row, ascii.data());
+
+    auto position = lines.text_.size();
+    lines.text_.append(digits, '0');
+    for (auto value = offset + start, i = position + digits; value != 0;
+         value >>= 4U) {
+      lines.text_[--i] = hex_digits[value & 0x0fU];
+    }
+    lines.text_.append(2, ' ');
+    for (size_t i = 0; i < row_size; ++i) {
+      if (i != 0 && i % hex_group_size == 0) {
+        lines.text_ += ' ';
+      }
+      // Short last row: blanks keep the ASCII column in line
+      if (i < row.size()) {
+        lines.text_.append(hex.data() + (i * 2), 2);
+        lines.text_ += ' ';
+      } else {
+        lines.text_.append(3, ' ');
+      }
+    }
+    lines.text_ += " |";
+    lines.text_.append(ascii.data(), row.size());
+    lines.text_ += '|';
+    lines.offsets_.push_back(static_cast<std::uint32_t>(lines.text_.size()));
+  }
+  return lines;
+}
+
+std::optional<TextLines> read_hex(const fs::path &path, std::uint64_t offset,
+                                  size_t columns, size_t rows) {
+  auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return std::nullopt;
+  }
+  struct stat st{};
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return std::nullopt;
+  }
+  auto size = static_cast<std::uint64_t>(st.st_size);
+  auto row_size = hex_row_size(columns);
+  if (size == 0) {
+    close(fd);
+    return TextLines{};
+  }
+  auto last_row = (size - 1) / row_size * row_size;
+  auto start = std::min(offset / row_size * row_size, last_row);
+  auto length = std::min<std::uint64_t>(rows * row_size, size - start);
+
+  std::vector<std::uint8_t> bytes(static_cast<size_t>(length));
+  size_t read = 0;
+  while (read < bytes.size()) {
+    auto got = pread(fd, bytes.data() + read, bytes.size() - read,
+                     static_cast<off_t>(start + read));
+    if (got <= 0) {
+      break;
+    }
+    read += static_cast<size_t>(got);
+  }
+  close(fd);
+  bytes.resize(read);
+  return hex_lines(bytes, start, row_size);
+}
+
+std::optional<std::uint64_t> parse_offset(std::string_view text) {
+  auto first = text.find_first_not_of(' ');
+  if (first == std::string_view::npos) {
+    return std::nullopt;
+  }
+  text = text.substr(first, text.find_last_not_of(' ') - first + 1);
+  auto base = 10;
+  if (text.starts_with("0x") || text.starts_with("0X")) {
+    text.remove_prefix(2);
+    base = 16;
+  }
+  std::uint64_t offset = 0;
+  const auto *end = text.data() + text.size();
+  auto [last, error] = std::from_chars(text.data(), end, offset, base);
+  if (text.empty() || error != std::errc{} || last != end) {
+    return std::nullopt;
+  }
+  return offset;
+}
+
+} // namespace duck
@@ -0,0 +1,530 @@
+#include "highlighter.hpp"
+#include <algorithm>
+#include <array>
+#include <span>
+
+namespace duck {
+
+using State = Highlighter::State;
+
+namespace {
+
+struct ExtensionLanguage {
+  std::string_view extension_;
+  Language language_;
+};
+
+constexpr std::array<ExtensionLanguage, 18> extension_languages{{
+    {".c", Language::Cpp},       {".h", Language::Cpp},
+    {".cc", Language::Cpp},      {".cpp", Language::Cpp},
+    {".cxx", Language::Cpp},     {".hh", Language::Cpp},
+    {".hpp", Language::Cpp},     {".hxx", Language::Cpp},
+    {".py", Language::Python},   {".pyi", Language::Python},
+    {".json", Language::Json},   {".yaml", Language::Yaml},
+    {".yml", Language::Yaml},    {".sh", Language::Shell},
+    {".bash", Language::Shell},  {".zsh", Language::Shell},
+    {".md", Language::Markdown}, {".markdown", Language::Markdown},
+}};
+
+// Sorted for binary search
+constexpr std::array<std::string_view, 81> cpp_keywords{
+    "alignas", "alignof", "auto", "bool", "break", "case", "catch", "char",
+    "char16_t", "char32_t", "char8_t", "class", "co_await", "co_return",
+    "co_yield", "concept", "const", "const_cast", "consteval", "constexpr",
+    "constinit", "continue", "decltype", "default", "delete", "do", "double",
+    "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false",
+    "final", "float", "for", "friend", "goto", "if", "inline", "int", "long",
+    "mutable", "namespace", "new", "noexcept", "nullptr", "operator",
+    "override", "private", "protected", "public", "register",
+    "reinterpret_cast", "requires", "return", "short", "signed", "sizeof",
+    "static", "static_assert", "static_cast", "struct", "switch", "template",
+    "this", "thread_local", "throw", "true", "try", "typedef", "typeid",
+    "typename", "union", "unsigned", "using", "virtual", "void", "volatile",
+    "while"};
+
+constexpr std::array<std::string_view, 35> python_keywords{
+    "False", "None", "True", "and", "as", "assert", "async", "await", "break",
+    "class", "continue", "def", "del", "elif", "else", "except", "finally",
+    "for", "from", "global", "if", "import", "in", "is", "lambda", "nonlocal",
+    "not", "or", "pass", "raise", "return", "try", "while", "with", "yield"};
+
+constexpr std::array<std::string_view, 17> shell_keywords{
+    "case", "do", "done", "elif", "else", "esac", "export", "fi", "for",
+    "function", "if", "in", "local", "return", "then", "until", "while"};
+
+constexpr std::array<std::string_view, 3> json_literals{"false", "null",
+                                                       "true"};
+
+constexpr std::array<std::string_view, 8> yaml_literals{
+    "false", "no", "null", "off", "on", "true", "yes", "~"};
+
+static_assert(std::ranges::is_sorted(cpp_keywords) &&
+              std::ranges::is_sorted(python_keywords) &&
+              std::ranges::is_sorted(shell_keywords) &&
+              std::ranges::is_sorted(json_literals) &&
+              std::ranges::is_sorted(yaml_literals));
+
+// Appends tokens of one line, shifted to where the line starts in the text
+class Emitter {
+private:
+  std::vector<Token> &tokens_;
+  std::uint32_t base_;
+
+public:
+  Emitter(std::vector<Token> &tokens, std::uint32_t base)
+      : tokens_{tokens}, base_{base} {}
+
+  void operator()(size_t begin, size_t end, TokenKind kind) {
+    if (begin < end) {
+      tokens_.push_back({.begin_ = base_ + static_cast<std::uint32_t>(begin),
+                         .end_ = base_ + static_cast<std::uint32_t>(end),
+                         .kind_ = kind});
+    }
+  }
+};
+
+bool is_digit(char character) { return character >= '0' && character <= '9'; }
+
+bool is_identifier_start(char character) {
+  return (character >= 'a' && character <= 'z') ||
+         (character >= 'A' && character <= 'Z') || character == '_';
+}
+
+bool is_identifier_char(char character) {
+  return is_identifier_start(character) || is_digit(character);
+}
+
+bool is_space(char character) { return character == ' ' || character == '\t'; }
+
+size_t skip_spaces(std::string_view line, size_t i) {
+  while (i < line.size() && is_space(line[i])) {
+    ++i;
+  }
+  return i;
+}
+
+size_t skip_identifier(std::string_view line, size_t i) {
+  while (i < line.size() && is_identifier_char(line[i])) {
+    ++i;
+  }
+  return i;
+}
+
+// Digits, letters for suffixes, hex and exponents, dots and separators
+size_t skip_number(std::string_view line, size_t i) {
+  while (i < line.size() &&
+         (is_identifier_char(line[i]) || line[i] == '.' || line[i] == '\'')) {
+    ++i;
+  }
+  return i;
+}
+
+// `i` is at the opening quote. Returns the end of the closing quote, or of
+// the line for a string the line cuts off.
+size_t skip_string(std::string_view line, size_t i) {
+  auto quote = line[i];
+  for (++i; i < line.size(); ++i) {
+    if (line[i] == '\\') {
+      ++i;
+    } else if (line[i] == quote) {
+      return i + 1;
+    }
+  }
+  return line.size();
+}
+
+bool contains(std::span<const std::string_view> sorted, std::string_view word) {
+  return std::ranges::binary_search(sorted, word);
+}
+
+void cpp_line(std::string_view line, State &state, Emitter &emit) {
+  size_t i = 0;
+  if (state == State::BlockComment) {
+    auto end = line.find("*/");
+    if (end == std::string_view::npos) {
+      emit(0, line.size(), TokenKind::Comment);
+      return;
+    }
+    emit(0, end + 2, TokenKind::Comment);
+    state = State::Normal;
+    i = end + 2;
+  } else if (auto start = skip_spaces(line, 0);
+             start < line.size() && line[start] == '#') {
+    i = std::min(line.find("//", start), line.find("/*", start));
+    i = std::min(i, line.size());
+    emit(start, i, TokenKind::Preprocessor);
+  }
+
+  while (i < line.size()) {
+    auto character = line[i];
+    auto next = i + 1 < line.size() ? line[i + 1] : '\0';
+    if (character == '/' && next == '/') {
+      emit(i, line.size(), TokenKind::Comment);
+      return;
+    }
+    if (character == '/' && next == '*') {
+      auto end = line.find("*/", i + 2);
+      if (end == std::string_view::npos) {
+        emit(i, line.size(), TokenKind::Comment);
+        state = State::BlockComment;
+        return;
+      }
+      emit(i, end + 2, TokenKind::Comment);
+      i = end + 2;
+    } else if (character == '"' || character == '\'') {
+      auto end = skip_string(line, i);
+      emit(i, end, TokenKind::String);
+      i = end;
+    } else if (is_digit(character)) {
+      auto end = skip_number(line, i);
+      emit(i, end, TokenKind::Number);
+      i = end;
+    } else if (is_identifier_start(character)) {
+      auto end = skip_identifier(line, i);
+      if (contains(cpp_keywords, line.substr(i, end - i))) {
+        emit(i, end, TokenKind::Keyword);
+      }
+      i = end;
+    } else {
+      ++i;
+    }
+  }
+}
+
+void python_line(std::string_view line, State &state, Emitter &emit) {
+  size_t i = 0;
+  if (state == State::TripleSingle || state == State::TripleDouble) {
+    auto end = line.find(state == State::TripleSingle ? "'''" : "\"\"\"");
+    if (end == std::string_view::npos) {
+      emit(0, line.size(), TokenKind::String);
+      return;
+    }
+    emit(0, end + 3, TokenKind::String);
+    state = State::Normal;
+    i = end + 3;
+  } else if (auto start = skip_spaces(line, 0);
+             start < line.size() && line[start] == '@') {
+    i = start + 1;
+    while (i < line.size() && (is_identifier_char(line[i]) || line[i] == '.')) {
+      ++i;
+    }
+    emit(start, i, TokenKind::Preprocessor);
+  }
+
+  while (i < line.size()) {
+    auto character = line[i];
+    if (character == '#') {
+      emit(i, line.size(), TokenKind::Comment);
+      return;
+    }
+    if (character == '"' || character == '\'') {
+      auto triple = std::string_view{character == '"' ? "\"\"\"" : "'''"};
+      if (line.substr(i).starts_with(triple)) {
+        auto end = line.find(triple, i + 3);
+        if (end == std::string_view::npos) {
+          emit(i, line.size(), TokenKind::String);
+          state = character == '"' ? State::TripleDouble : State::TripleSingle;
+          return;
+        }
+        emit(i, end + 3, TokenKind::String);
+        i = end + 3;
+      } else {
+        auto end = skip_string(line, i);
+        emit(i, end, TokenKind::String);
+        i = end;
+      }
+    } else if (is_digit(character)) {
+      auto end = skip_number(line, i);
+      emit(i, end, TokenKind::Number);
+      i = end;
+    } else if (is_identifier_start(character)) {
+      auto end = skip_identifier(line, i);
+      if (contains(python_keywords, line.substr(i, end - i))) {
+        emit(i, end, TokenKind::Keyword);
+      }
+      i = end;
+    } else {
+      ++i;
+    }
+  }
+}
+
+void json_line(std::string_view line, Emitter &emit) {
+  size_t i = 0;
+  while (i < line.size()) {
+    auto character = line[i];
+    if (character == '"') {
+      auto end = skip_string(line, i);
+      auto after = skip_spaces(line, end);
+      emit(i, end,
+           after < line.size() && line[after] == ':' ? TokenKind::Key
+                                                     : TokenKind::String);
+      i = end;
+    } else if (is_digit(character) ||
+               (character == '-' && i + 1 < line.size() &&
+                is_digit(line[i + 1]))) {
+      auto end = skip_number(line, i + 1);
+      emit(i, end, TokenKind::Number);
+      i = end;
+    } else if (is_identifier_start(character)) {
+      auto end = skip_identifier(line, i);
+      if (contains(json_literals, line.substr(i, end - i))) {
+        emit(i, end, TokenKind::Keyword);
+      }
+      i = end;
+    } else {
+      ++i;
+    }
+  }
+}
+
+// Scalars, quoted strings, anchors and comments after a key or list marker
+void yaml_value(std::string_view line, size_t i, Emitter &emit) {
+  while (i < line.size()) {
+    auto character = line[i];
+    auto word_start = i == 0 || is_space(line[i - 1]);
+    if (character == '#' && word_start) {
+      emit(i, line.size(), TokenKind::Comment);
+      return;
+    }
+    if ((character == '"' || character == '\'') && word_start) {
+      auto end = skip_string(line, i);
+      emit(i, end, TokenKind::String);
+      i = end;
+    } else if ((character == '&' || character == '*') && word_start) {
+      auto end = skip_identifier(line, i + 1);
+      emit(i, end, TokenKind::Preprocessor);
+      i = end;
+    } else if (word_start && !is_space(character)) {
+      auto end = i;
+      while (end < line.size() && !is_space(line[end])) {
+        ++end;
+      }
+      auto word = line.substr(i, end - i);
+      if (contains(yaml_literals, word)) {
+        emit(i, end, TokenKind::Keyword);
+      } else if (is_digit(word.front()) ||
+                 (word.size() > 1 && word.front() == '-' &&
+                  is_digit(word[1]))) {
+        emit(i, end, TokenKind::Number);
+      }
+      i = end;
+    } else {
+      ++i;
+    }
+  }
+}
+
+void yaml_line(std::string_view line, Emitter &emit) {
+  if (line.starts_with("---") || line.starts_with("...")) {
+    emit(0, 3, TokenKind::Keyword);
+    yaml_value(line, 3, emit);
+    return;
+  }
+
+  auto i = skip_spaces(line, 0);
+  while (i + 1 < line.size() && line[i] == '-' && is_space(line[i + 1])) {
+    emit(i, i + 1, TokenKind::Keyword);
+    i = skip_spaces(line, i + 1);
+  }
+  if (i < line.size() && line[i] == '#') {
+    emit(i, line.size(), TokenKind::Comment);
+    return;
+  }
+
+  // A key ends at the first colon followed by a space or the line's end
+  auto end = i < line.size() && (line[i] == '"' || line[i] == '\'')
+                 ? skip_string(line, i)
+                 : i;
+  while (end < line.size() && line[end] != ':' && line[end] != '#') {
+    ++end;
+  }
+  if (end < line.size() && line[end] == ':' &&
+      (end + 1 == line.size() || is_space(line[end + 1]))) {
+    emit(i, end, TokenKind::Key);
+    i = end + 1;
+  }
+  yaml_value(line, i, emit);
+}
+
+void shell_line(std::string_view line, Emitter &emit) {
+  size_t i = 0;
+  while (i < line.size()) {
+    auto character = line[i];
+    auto word_start =
+        i == 0 || is_space(line[i - 1]) || line[i - 1] == ';';
+    if (character == '#' && word_start) {
+      emit(i, line.size(), TokenKind::Comment);
+      return;
+    }
+    if (character == '\'') {
+      auto end = std::min(line.find('\'', i + 1), line.size() - 1) + 1;
+      emit(i, end, TokenKind::String);
+      i = end;
+    } else if (character == '"') {
+      auto end = skip_string(line, i);
+      emit(i, end, TokenKind::String);
+      i = end;
+    } else if (character == '$' && i + 1 < line.size()) {
+      auto end = i + 2;
+      if (line[i + 1] == '{') {
+        end = std::min(line.find('}', i), line.size() - 1) + 1;
+      } else if (is_identifier_char(line[i + 1])) {
+        end = skip_identifier(line, i + 1);
+      }
+      emit(i, end, TokenKind::Key);
+      i = end;
+    } else if (is_identifier_start(character) && word_start) {
+      auto end = i;
+      while (end < line.size() && !is_space(line[end]) && line[end] != ';') {
+        ++end;
+      }
+      if (contains(shell_keywords, line.substr(i, end - i))) {
+        emit(i, end, TokenKind::Keyword);
+      }
+      i = end;
+    } else {
+      ++i;
+    }
+  }
+}
+
+void markdown_line(std::string_view line, State &state, Emitter &emit) {
+  auto i = skip_spaces(line, 0);
+  auto rest = line.substr(i);
+  if (rest.starts_with("```") || rest.starts_with("~~~")) {
+    state = state == State::Fence ? State::Normal : State::Fence;
+    emit(0, line.size(), TokenKind::Code);
+    return;
+  }
+  if (state == State::Fence) {
+    emit(0, line.size(), TokenKind::Code);
+    return;
+  }
+  if (rest.starts_with('#')) {
+    emit(i, line.size(), TokenKind::Heading);
+    return;
+  }
+  if (rest.starts_with('>')) {
+    emit(i, line.size(), TokenKind::Comment);
+    return;
+  }
+
+  // List markers
+  auto marker = i;
+  while (marker < line.size() && is_digit(line[marker])) {
+    ++marker;
+  }
+  if (marker > i && marker < line.size() &&
+      (line[marker] == '.' || line[marker] == ')')) {
+    ++marker;
+  } else if (marker == i && marker < line.size() &&
+             (line[marker] == '-' || line[marker] == '*' ||
+              line[marker] == '+')) {
+    ++marker;
+  }
+  if (marker > i && (marker == line.size() || is_space(line[marker]))) {
+    emit(i, marker, TokenKind::Keyword);
+    i = marker;
+  }
+
+  while (i < line.size()) {
+    if (line[i] == '`') {
+      auto end = line.find('`', i + 1);
+      if (end == std::string_view::npos) {
+        return;
+      }
+      emit(i, end + 1, TokenKind::Code);
+      i = end + 1;
+    } else if (line.substr(i).starts_with("**")) {
+      auto end = line.find("**", i + 2);
+      if (end == std::string_view::npos) {
+        return;
+      }
+      emit(i, end + 2, TokenKind::Keyword);
+      i = end + 2;
+    } else if (line.substr(i).starts_with("](")) {
+      auto end = std::min(line.find(')', i), line.size() - 1) + 1;
+      emit(i + 1, end, TokenKind::String);
+      i = end;
+    } else {
+      ++i;
+    }
+  }
+}
+
+bool equals_ignoring_case(std::string_view text, std::string_view lower) {
+  return std::ranges::equal(text, lower, [](char first, char second) {
+    return (first >= 'A' && first <= 'Z' ? first - 'A' + 'a' : first) ==
+           second;
+  });
+}
+
+} // namespace
+
+Language detect_language(const fs::path &path, std::string_view first_line) {
+  auto extension = path.extension().native();
+  auto it = std::ranges::find_if(
+      extension_languages, [&extension](const ExtensionLanguage &candidate) {
+        return equals_ignoring_case(extension, candidate.extension_);
+      });
+  if (it != extension_languages.end()) {
+    return it->language_;
+  }
+  if (first_line.starts_with("#!")) {
+    if (first_line.find("python") != std::string_view::npos) {
+      return Language::Python;
+    }
+    if (first_line.find("sh") != std::string_view::npos) {
+      return Language::Shell;
+    }
+  }
+  return Language::Plain;
+}
+
+void Highlighter::highlight_line(std::string_view line, std::uint32_t base,
+                                 std::vector<Token> &tokens) {
+  Emitter emit{tokens, base};
+  switch (language_) {
+  case Language::Plain:
+    break;
+  case Language::Cpp:
+    cpp_line(line, state_, emit);
+    break;
+  case Language::Python:
+    python_line(line, state_, emit);
+    break;
+  case Language::Json:
+    json_line(line, emit);
+    break;
+  case Language::Yaml:
+    yaml_line(line, emit);
+    break;
+  case Language::Shell:
+    shell_line(line, emit);
+    break;
+  case Language::Markdown:
+    markdown_line(line, state_, emit);
+    break;
+  }
+}
+
+std::optional<HighlightedLines>
+highlight(TextLinesPtr lines, Language language,
+          const std::function<bool()> &stopped) {
+  HighlightedLines result{.lines_ = lines};
+  result.token_offsets_.reserve(lines->size() + 1);
+  Highlighter highlighter{language};
+  for (size_t i = 0; i < lines->size(); ++i) {
+    if (stopped()) {
+      return std::nullopt;
+    }
+    highlighter.highlight_line(lines->line(i), lines->offsets_[i],
+                               result.tokens_);
+    result.token_offsets_.push_back(
+        static_cast<std::uint32_t>(result.tokens_.size()));
+  }
+  return result;
+}
+
+} // namespace duck
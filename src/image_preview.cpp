@@ -0,0 +1,628 @@
+#include "image_preview.hpp"
+#include <algorithm>
+#include <array>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <jpeglib.h>
+#include <png.h>
+#include <sys/stat.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace duck {
+
+namespace {
+
+constexpr size_t lzw_max_codes = 4096;
+constexpr unsigned lzw_max_bits = 12;
+
+// Reads little-endian fields; past the end it yields zeros and remembers
+// that it ran out
+class ByteReader {
+private:
+  std::span<const std::uint8_t> bytes_;
+  size_t position_ = 0;
+  bool failed_ = false;
+
+public:
+  explicit ByteReader(std::span<const std::uint8_t> bytes) : bytes_{bytes} {}
+
+  [[nodiscard]] bool failed() const { return failed_; }
+
+  std::uint8_t byte() {
+    if (position_ >= bytes_.size()) {
+      failed_ = true;
+      return 0;
+    }
+    return bytes_[position_++];
+  }
+
+  std::uint16_t word() {
+    auto low = byte();
+    return static_cast<std::uint16_t>(low | (byte() << 8U));
+  }
+
+  std::span<const std::uint8_t> take(size_t count) {
+    if (count > bytes_.size() - position_) {
+      failed_ = true;
+      position_ = bytes_.size();
+      return {};
+    }
+    auto taken = bytes_.subspan(position_, count);
+    position_ += count;
+    return taken;
+  }
+
+  // Concatenates GIF data sub-blocks up to the empty one
+  std::vector<std::uint8_t> sub_blocks() {
+    std::vector<std::uint8_t> data;
+    for (auto size = byte(); size != 0 && !failed_; size = byte()) {
+      auto block = take(size);
+      data.insert(data.end(), block.begin(), block.end());
+    }
+    return data;
+  }
+};
+
+// Variable-length LZW as GIF uses it, codes packed from the low bit up.
+// Stops at the end code, the end of the data or once `count` indices are
+// out, so a truncated stream yields fewer.
+std::optional<std::vector<std::uint8_t>>
+decode_lzw(std::span<const std::uint8_t> data, unsigned min_code_size,
+           size_t count) {
+  if (min_code_size < 2 || min_code_size > 8) {
+    return std::nullopt;
+  }
+  std::array<std::uint16_t, lzw_max_codes> prefix{};
+  std::array<std::uint8_t, lzw_max_codes> suffix{};
+  std::array<std::uint8_t, lzw_max_codes> first{};
+  std::array<std::uint16_t, lzw_max_codes> length{};
+  const unsigned clear = 1U << min_code_size;
+  const unsigned end = clear + 1;
+  for (unsigned code = 0; code < clear; ++code) {
+    suffix[code] = first[code] = static_cast<std::uint8_t>(code);
+    length[code] = 1;
+  }
+
+  std::vector<std::uint8_t> indices;
+  indices.reserve(count);
+  // Writes the string of `code` back to front
+  auto emit = [&](unsigned code) {
+    auto size = indices.size();
+    indices.resize(size + length[code]);
+    for (auto i = size + length[code]; i-- > size;) {
+      indices[i] = suffix[code];
+      code = prefix[code];
+    }
+  };
+
+  auto code_size = min_code_size + 1;
+  auto next = clear + 2;
+  auto previous = lzw_max_codes;
+  std::uint32_t buffer = 0;
+  unsigned bits = 0;
+  size_t position = 0;
+  while (indices.size() < count) {
+    while (bits < code_size && position < data.size()) {
+      buffer |= std::uint32_t{data[position++]} << bits;
+      bits += 8;
+    }
+    if (bits < code_size) {
+      break;
+    }
+    auto code = buffer & ((1U << code_size) - 1);
+    buffer >>= code_size;
+    bits -= code_size;
+
+    if (code == clear) {
+      code_size = min_code_size + 1;
+      next = clear + 2;
+      previous = lzw_max_codes;
+      continue;
+    }
+    if (code == end) {
+      break;
+    }
+    if (previous == lzw_max_codes) {
+      if (code > clear) {
+        return std::nullopt;
+      }
+      emit(code);
+      previous = code;
+      continue;
+    }
+    if (code > next || (code == next && next == lzw_max_codes)) {
+      return std::nullopt;
+    }
+    // The code being defined right now is the previous string plus its
+    // own first index
+    auto head = code < next ? first[code] : first[previous];
+    if (next < lzw_max_codes) {
+      prefix[next] = static_cast<std::uint16_t>(previous);
+      suffix[next] = head;
+      first[next] = first[previous];
+      length[next] = static_cast<std::uint16_t>(length[previous] + 1);
+      ++next;
+      if (next == (1U << code_size) && code_size < lzw_max_bits) {
+        ++code_size;
+      }
+    }
+    emit(code);
+    previous = code;
+  }
+  indices.resize(std::min(indices.size(), count));
+  return indices;
+}
+
+// Whole file, or nullopt if it can't be read or is larger than `limit`
+std::optional<std::vector<std::uint8_t>> read_file(const fs::path &path,
+                                                   size_t limit) {
+  auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return std::nullopt;
+  }
+  struct stat st{};
+  if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) > limit) {
+    close(fd);
+    return std::nullopt;
+  }
+  std::vector<std::uint8_t> bytes(static_cast<size_t>(st.st_size));
+  size_t size = 0;
+  while (size < bytes.size()) {
+    auto got = pread(fd, bytes.data() + size, bytes.size() - size,
+                     static_cast<off_t>(size));
+    if (got <= 0) {
+      break;
+    }
+    size += static_cast<size_t>(got);
+  }
+  close(fd);
+  bytes.resize(size);
+  return bytes;
+}
+
+std::optional<Image> decode_png(const fs::path &path) {
+  png_image png{};
+  png.version = PNG_IMAGE_VERSION;
+  if (png_image_begin_read_from_file(&png, path.c_str()) == 0) {
+    return std::nullopt;
+  }
+  if (size_t{png.width} * png.height > image_pixel_limit) {
+    png_image_free(&png);
+    return std::nullopt;
+  }
+  png.format = PNG_FORMAT_RGBA;
+  Image image{.width_ = png.width, .height_ = png.height};
+  image.pixels_.resize(PNG_IMAGE_SIZE(png));
+  if (png_image_finish_read(&png, nullptr, image.pixels_.data(), 0,
+                            nullptr) == 0) {
+    png_image_free(&png);
+    return std::nullopt;
+  }
+  return image;
+}
+
+struct JpegErrors {
+  jpeg_error_mgr manager_;
+  std::jmp_buf jump_;
+};
+
+[[noreturn]] void jpeg_fail(j_common_ptr info) {
+  std::longjmp(reinterpret_cast<JpegErrors *>(info->err)->jump_, 1);
+}
+
+// libjpeg prints warnings to stderr, right over the UI
+void jpeg_quiet(j_common_ptr /*info*/) {}
+
+std::optional<Image> decode_jpeg(const fs::path &path,
+                                 std::uint32_t box_width,
+                                 std::uint32_t box_height) {
+  auto *file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return std::nullopt;
+  }
+  // Everything that changes after setjmp lives on the heap or in `info`
+  auto image = std::make_unique<Image>();
+  jpeg_decompress_struct info{};
+  JpegErrors errors{};
+  info.err = jpeg_std_error(&errors.manager_);
+  errors.manager_.error_exit = jpeg_fail;
+  errors.manager_.output_message = jpeg_quiet;
+  if (setjmp(errors.jump_) != 0) {
+    jpeg_destroy_decompress(&info);
+    std::fclose(file);
+    return std::nullopt;
+  }
+
+  jpeg_create_decompress(&info);
+  jpeg_stdio_src(&info, file);
+  jpeg_read_header(&info, TRUE);
+  info.out_color_space = JCS_RGB;
+  // The IDCT scales by 1/8, 1/4 or 1/2 for free: take the smallest scale
+  // that still covers the size shown
+  auto [width, height] = fit_size(info.image_width, info.image_height,
+                                  box_width, box_height);
+  info.scale_num = 1;
+  info.scale_denom = 8;
+  auto scaled = [](JDIMENSION size, unsigned denom) {
+    return (size + denom - 1) / denom;
+  };
+  while (info.scale_denom > 1 &&
+         (scaled(info.image_width, info.scale_denom) < width ||
+          scaled(info.image_height, info.scale_denom) < height)) {
+    info.scale_denom /= 2;
+  }
+  jpeg_calc_output_dimensions(&info);
+  if (size_t{info.output_width} * info.output_height > image_pixel_limit) {
+    jpeg_destroy_decompress(&info);
+    std::fclose(file);
+    return std::nullopt;
+  }
+
+  jpeg_start_decompress(&info);
+  image->width_ = info.output_width;
+  image->height_ = info.output_height;
+  image->pixels_.resize(size_t{image->width_} * image->height_ * 4);
+  while (info.output_scanline < info.output_height) {
+    // RGB goes into the last three quarters of the row, then spreads out
+    // to RGBA from the left without overtaking what it reads
+    auto *row = image->pixels_.data() +
+                size_t{info.output_scanline} * image->width_ * 4;
+    JSAMPROW rgb = row + image->width_;
+    jpeg_read_scanlines(&info, &rgb, 1);
+    for (size_t x = 0; x < image->width_; ++x) {
+      std::array<std::uint8_t, 3> pixel{rgb[x * 3], rgb[(x * 3) + 1],
+                                        rgb[(x * 3) + 2]};
+      std::memcpy(row + (x * 4), pixel.data(), pixel.size());
+      row[(x * 4) + 3] = 0xff;
+    }
+  }
+  jpeg_finish_decompress(&info);
+  jpeg_destroy_decompress(&info);
+  std::fclose(file);
+  if (image->width_ == width && image->height_ == height) {
+    return std::move(*image);
+  }
+  // Fitted from the original size, which rounds differently
+  return resize_image(*image, width, height);
+}
+
+// Skips whitespace and comments, then reads a decimal number
+std::optional<std::uint32_t>
+netpbm_number(std::span<const std::uint8_t> bytes, size_t &position) {
+  while (position < bytes.size()) {
+    auto byte = bytes[position];
+    if (byte == '#') {
+      while (position < bytes.size() && bytes[position] != '\n') {
+        ++position;
+      }
+    } else if (byte == ' ' || byte == '\t' || byte == '\n' || byte == '\r') {
+      ++position;
+    } else {
+      break;
+    }
+  }
+  std::uint32_t number = 0;
+  auto start = position;
+  while (position < bytes.size() && bytes[position] >= '0' &&
+         bytes[position] <= '9' && position - start < 9) {
+    number = (number * 10) + (bytes[position++] - '0');
+  }
+  if (position == start) {
+    return std::nullopt;
+  }
+  return number;
+}
+
+// Adds `count` bytes of `row` to as many 32-bit sums
+void add_row(std::uint32_t *sums, const std::uint8_t *row, size_t count) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  auto zero = _mm_setzero_si128();
+  for (; i + 16 <= count; i += 16) {
+    auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+    auto low = _mm_unpacklo_epi8(bytes, zero);
+    auto high = _mm_unpackhi_epi8(bytes, zero);
+    auto add = [sums = sums + i](size_t offset, __m128i words) {
+      auto *sum = reinterpret_cast<__m128i *>(sums + offset);
+      _mm_storeu_si128(sum, _mm_add_epi32(_mm_loadu_si128(sum), words));
+    };
+    add(0, _mm_unpacklo_epi16(low, zero));
+    add(4, _mm_unpackhi_epi16(low, zero));
+    add(8, _mm_unpacklo_epi16(high, zero));
+    add(12, _mm_unpackhi_epi16(high, zero));
+  }
+#endif
+  for (; i < count; ++i) {
+    sums[i] += row[i];
+  }
+}
+
+// Mean of the column sums of pixels [begin, end), over `area` pixels in
+// all, as one RGBA pixel
+void mean_pixel(const std::uint32_t *sums, size_t begin, size_t end,
+                size_t area, std::uint8_t *pixel) {
+#if defined(__SSE2__)
+  auto total = _mm_setzero_si128();
+  for (auto x = begin; x < end; ++x) {
+    const auto *sum = reinterpret_cast<const __m128i *>(sums + (x * 4));
+    total = _mm_add_epi32(total, _mm_loadu_si128(sum));
+  }
+  // Converting back rounds to nearest
+  auto mean = _mm_cvtps_epi32(_mm_mul_ps(
+      _mm_cvtepi32_ps(total), _mm_set1_ps(1.0F / static_cast<float>(area))));
+  auto packed = _mm_packus_epi16(_mm_packs_epi32(mean, mean), mean);
+  auto value = _mm_cvtsi128_si32(packed);
+  std::memcpy(pixel, &value, 4);
+#else
+  std::array<std::uint32_t, 4> total{};
+  for (auto x = begin; x < end; ++x) {
+    for (size_t channel = 0; channel < 4; ++channel) {
+      total[channel] += sums[(x * 4) + channel];
+    }
+  }
+  for (size_t channel = 0; channel < 4; ++channel) {
+    pixel[channel] =
+        static_cast<std::uint8_t>((total[channel] + (area / 2)) / area);
+  }
+#endif
+}
+
+} // namespace
+
+bool is_image(ContentType type) {
+  return type == ContentType::Png || type == ContentType::Jpeg ||
+         type == ContentType::Gif || type == ContentType::Netpbm;
+}
+
+std::pair<std::uint32_t, std::uint32_t>
+fit_size(std::uint32_t width, std::uint32_t height, std::uint32_t box_width,
+         std::uint32_t box_height) {
+  box_width = std::max(box_width, 1U);
+  box_height = std::max(box_height, 1U);
+  if (width == 0 || height == 0) {
+    return {1, 1};
+  }
+  if (width <= box_width && height <= box_height) {
+    return {width, height};
+  }
+  auto scale = [](std::uint64_t size, std::uint64_t to, std::uint64_t from) {
+    return static_cast<std::uint32_t>(
+        std::max<std::uint64_t>(((size * to) + (from / 2)) / from, 1));
+  };
+  if (std::uint64_t{width} * box_height > std::uint64_t{height} * box_width) {
+    return {box_width, scale(height, box_width, width)};
+  }
+  return {scale(width, box_height, height), box_height};
+}
+
+std::optional<Image> decode_gif(std::span<const std::uint8_t> bytes) {
+  ByteReader reader{bytes};
+  auto signature = reader.take(6);
+  if (reader.failed() || std::memcmp(signature.data(), "GIF8", 4) != 0) {
+    return std::nullopt;
+  }
+  auto width = reader.word();
+  auto height = reader.word();
+  auto flags = reader.byte();
+  reader.take(2);
+  if (width == 0 || height == 0 ||
+      size_t{width} * height > image_pixel_limit) {
+    return std::nullopt;
+  }
+  std::span<const std::uint8_t> global_colors;
+  if ((flags & 0x80U) != 0) {
+    global_colors = reader.take(3 * (size_t{2} << (flags & 0x07U)));
+  }
+
+  std::optional<std::uint8_t> transparent;
+  while (!reader.failed()) {
+    auto block = reader.byte();
+    if (block == 0x21) {
+      auto label = reader.byte();
+      auto data = reader.sub_blocks();
+      // Graphic control: the transparent index of the next image
+      if (label == 0xf9 && data.size() >= 4 && (data[0] & 0x01U) != 0) {
+        transparent = data[3];
+      }
+      continue;
+    }
+    if (block != 0x2c) {
+      return std::nullopt;
+    }
+
+    auto left = reader.word();
+    auto top = reader.word();
+    auto frame_width = reader.word();
+    auto frame_height = reader.word();
+    auto frame_flags = reader.byte();
+    auto colors = global_colors;
+    if ((frame_flags & 0x80U) != 0) {
+      colors = reader.take(3 * (size_t{2} << (frame_flags & 0x07U)));
+    }
+    auto min_code_size = reader.byte();
+    if (reader.failed() || colors.empty()) {
+      return std::nullopt;
+    }
+    // Whatever a truncated file has is shown, the rest stays transparent
+    auto data = reader.sub_blocks();
+    auto indices = decode_lzw(data, min_code_size,
+                              size_t{frame_width} * frame_height);
+    if (!indices) {
+      return std::nullopt;
+    }
+
+    // Interlaced rows come every 8th from 0, every 8th from 4, every 4th
+    // from 2, then every 2nd from 1
+    std::vector<std::uint32_t> rows;
+    rows.reserve(frame_height);
+    if ((frame_flags & 0x40U) != 0) {
+      constexpr std::array<std::pair<unsigned, unsigned>, 4> passes{
+          {{0, 8}, {4, 8}, {2, 4}, {1, 2}}};
+      for (auto [start, step] : passes) {
+        for (auto row = start; row < frame_height; row += step) {
+          rows.push_back(row);
+        }
+      }
+    } else {
+      for (std::uint32_t row = 0; row < frame_height; ++row) {
+        rows.push_back(row);
+      }
+    }
+
+    Image image{.width_ = width, .height_ = height};
+    image.pixels_.resize(size_t{width} * height * 4);
+    auto palette_size = colors.size() / 3;
+    for (size_t i = 0; i < rows.size(); ++i) {
+      auto y = size_t{top} + rows[i];
+      if (y >= height) {
+        continue;
+      }
+      for (size_t x = 0; x < frame_width && left + x < width; ++x) {
+        auto position = (i * frame_width) + x;
+        if (position >= indices->size()) {
+          break;
+        }
+        auto index = (*indices)[position];
+        if (index == transparent || index >= palette_size) {
+          continue;
+        }
+        auto *pixel = image.pixels_.data() + ((y * width) + left + x) * 4;
+        std::memcpy(pixel, colors.data() + (size_t{index} * 3), 3);
+        pixel[3] = 0xff;
+      }
+    }
+    return image;
+  }
+  return std::nullopt;
+}
+
+std::optional<Image> decode_netpbm(std::span<const std::uint8_t> bytes) {
+  if (bytes.size() < 2 || bytes[0] != 'P' ||
+      (bytes[1] != '5' && bytes[1] != '6')) {
+    return std::nullopt;
+  }
+  size_t position = 2;
+  auto width = netpbm_number(bytes, position);
+  auto height = netpbm_number(bytes, position);
+  auto maxval = netpbm_number(bytes, position);
+  // A single whitespace byte separates the header from the samples
+  if (!width || !height || !maxval || *width == 0 || *height == 0 ||
+      *maxval == 0 || *maxval > 0xffff || position >= bytes.size() ||
+      size_t{*width} * *height > image_pixel_limit) {
+    return std::nullopt;
+  }
+  ++position;
+
+  size_t channels = bytes[1] == '6' ? 3 : 1;
+  size_t sample_size = *maxval < 0x100 ? 1 : 2;
+  auto pixels = size_t{*width} * *height;
+  if (bytes.size() - position < pixels * channels * sample_size) {
+    return std::nullopt;
+  }
+  Image image{.width_ = *width, .height_ = *height};
+  image.pixels_.resize(pixels * 4);
+  const auto *sample = bytes.data() + position;
+  auto next = [&sample, sample_size, maxval = *maxval]() {
+    std::uint32_t value = *sample++;
+    if (sample_size == 2) {
+      value = (value << 8U) | *sample++;
+    }
+    return static_cast<std::uint8_t>(((value * 255) + (maxval / 2)) /
+                                     maxval);
+  };
+  for (size_t i = 0; i < pixels; ++i) {
+    auto *pixel = image.pixels_.data() + (i * 4);
+    if (channels == 3) {
+      pixel[0] = next();
+      pixel[1] = next();
+      pixel[2] = next();
+    } else {
+      pixel[0] = pixel[1] = pixel[2] = next();
+    }
+    pixel[3] = 0xff;
+  }
+  return image;
+}
+
+Image resize_image(const Image &image, std::uint32_t width,
+                   std::uint32_t height) {
+  width = std::clamp(width, 1U, image.width_);
+  height = std::clamp(height, 1U, image.height_);
+  if (width == image.width_ && height == image.height_) {
+    return image;
+  }
+
+  // Output pixel x covers source columns [columns[x], columns[x + 1]),
+  // rows likewise
+  auto edges = [](std::uint32_t from, std::uint32_t to) {
+    std::vector<std::uint32_t> edges(to + 1);
+    for (std::uint32_t i = 0; i <= to; ++i) {
+      edges[i] = static_cast<std::uint32_t>(std::uint64_t{i} * from / to);
+    }
+    return edges;
+  };
+  auto columns = edges(image.width_, width);
+  auto rows = edges(image.height_, height);
+
+  Image resized{.width_ = width, .height_ = height};
+  resized.pixels_.resize(size_t{width} * height * 4);
+  tbb::parallel_for(
+      tbb::blocked_range<std::uint32_t>{0, height},
+      [&](const tbb::blocked_range<std::uint32_t> &range) {
+        std::vector<std::uint32_t> sums(size_t{image.width_} * 4);
+        for (auto y = range.begin(); y != range.end(); ++y) {
+          std::ranges::fill(sums, 0);
+          for (auto row = rows[y]; row < rows[y + 1]; ++row) {
+            add_row(sums.data(), image.pixel(0, row), sums.size());
+          }
+          auto *out = resized.pixels_.data() + size_t{y} * width * 4;
+          for (std::uint32_t x = 0; x < width; ++x) {
+            size_t area = size_t{columns[x + 1] - columns[x]} *
+                          (rows[y + 1] - rows[y]);
+            mean_pixel(sums.data(), columns[x], columns[x + 1], area,
+                       out + (size_t{x} * 4));
+          }
+        }
+      });
+  return resized;
+}
+
+std::optional<Image> decode_image(const fs::path &path, ContentType type,
+                                  std::uint32_t box_width,
+                                  std::uint32_t box_height,
+                                  const std::function<bool()> &stopped) {
+  if (stopped()) {
+    return std::nullopt;
+  }
+  std::optional<Image> image;
+  if (type == ContentType::Png) {
+    image = decode_png(path);
+  } else if (type == ContentType::Jpeg) {
+    image = decode_jpeg(path, box_width, box_height);
+  } else if (type == ContentType::Gif || type == ContentType::Netpbm) {
+    auto bytes = read_file(path, image_file_limit);
+    if (bytes) {
+      image = type == ContentType::Gif ? decode_gif(bytes.value())
+                                       : decode_netpbm(bytes.value());
+    }
+  }
+  if (!image || stopped()) {
+    return std::nullopt;
+  }
+  auto [width, height] =
+      fit_size(image->width_, image->height_, box_width, box_height);
+  if (width == image->width_ && height == image->height_) {
+    return image;
+  }
+  return resize_image(image.value(), width, height);
+}
+
+} // namespace duck
@@ -100,11 +100,21 @@ std::function<bool(ftxui::Event)> InputHandler::operation_handler() {
       return true;
     }
 
+    if (event == ftxui::Event::Character('s')) {
+      event_bus_.push_event(FmgrEvent{.type_ = FmgrEvent::Type::CycleSortMode});
+      return true;
+    }
+
     if (event == ftxui::Event::Character('n')) {
       event_bus_.push_event(RenderEvent{RenderEvent::Type::ToggleNotification});
       return true;
     }
 
+    if (event == ftxui::Event::Character('g')) {
+      event_bus_.push_event(RenderEvent{RenderEvent::Type::ToggleJumpDialog});
+      return true;
+    }
+
     return false;
   };
 }
@@ -161,4 +171,19 @@ InputHandler::creation_dialog_handler() {
   };
 }
 
+std::function<bool(const ftxui::Event &)> InputHandler::jump_dialog_handler() {
+  return [this](const ftxui::Event &event) {
+    if (event == ftxui::Event::Escape) {
+      event_bus_.push_event(RenderEvent{RenderEvent::Type::ToggleJumpDialog});
+      return true;
+    }
+
+    if (event == ftxui::Event::Return) {
+      event_bus_.push_event(FmgrEvent{.type_ = FmgrEvent::Type::JumpToOffset});
+      return true;
+    }
+    return false;
+  };
+}
+
 } // namespace duck
@@ -8,11 +8,6 @@ int main() {
 // TODO: Keep selecting current selected file when toggle hidden entries
 // TODO: Improve add_new_entry
 // TODO: Show a notification when try to mark entries in current dir
-// TODO: implement task cancelation
-// TODO: Add lazy loading for directory entries
 // TODO: Implement better log
-// TODO: Add preview for image
 // TODO: implement better color scheme
-// TODO: Add realtime response for filesystem changing;
-// TODO: Add code hilighting for preview
 // TODO: Add a parent dir pane
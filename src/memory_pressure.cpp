@@ -0,0 +1,32 @@
+#include "memory_pressure.hpp"
+#include <charconv>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+namespace duck {
+
+std::optional<double> memory_pressure() {
+  std::ifstream file{"/proc/pressure/memory"};
+  std::string line;
+  while (std::getline(file, line)) {
+    if (!line.starts_with("some ")) {
+      continue;
+    }
+    constexpr std::string_view key = "avg10=";
+    auto position = line.find(key);
+    if (position == std::string::npos) {
+      return std::nullopt;
+    }
+    const auto *begin = line.data() + position + key.size();
+    double value = 0;
+    if (std::from_chars(begin, line.data() + line.size(), value).ec !=
+        std::errc{}) {
+      return std::nullopt;
+    }
+    return value;
+  }
+  return std::nullopt;
+}
+
+} // namespace duck
@@ -0,0 +1,74 @@
+#include "prefetcher.hpp"
+#include "app_event.hpp"
+#include "file_manager.hpp"
+#include "scheduler.hpp"
+#include <algorithm>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace duck {
+
+namespace {
+
+constexpr int background_nice = 10;
+
+// Linux applies setpriority() with a thread id to that thread alone
+void lower_thread_priority() {
+  static thread_local const bool lowered =
+      setpriority(PRIO_PROCESS, static_cast<id_t>(gettid()),
+                  background_nice) == 0;
+  (void)lowered;
+}
+
+} // namespace
+
+Prefetcher::Prefetcher(EventBus &event_bus) : event_bus_{event_bus} {}
+
+void Prefetcher::prefetch(const std::vector<fs::path> &paths, SortMode mode) {
+  auto generation = ++generation_;
+  auto count = std::min(paths.size(), prefetch_budget);
+  for (size_t i = 0; i < count; ++i) {
+    ++issued_;
+    auto task =
+        stdexec::schedule(Scheduler::background_scheduler()) |
+        stdexec::then([this, path = paths[i], mode, generation]() {
+          lower_thread_priority();
+          auto stale = [this, generation]() {
+            return generation_.load(std::memory_order_relaxed) != generation;
+          };
+          auto directory = FileManager::load_directory_bounded(
+              path, mode, prefetch_max_entries, stale);
+          if (!directory || stale()) {
+            ++cancelled_;
+            return;
+          }
+          ++loaded_;
+          event_bus_.push_event(DirecotryLoaded{
+              .prefetched_ = true, .directory_ = std::move(directory.value())});
+        });
+    scope_.spawn(std::move(task));
+  }
+}
+
+void Prefetcher::cancel() { ++generation_; }
+
+void Prefetcher::record_loaded(const fs::path &path) { unused_.insert(path); }
+
+void Prefetcher::record_access(const fs::path &path, bool cached) {
+  // A prefetched listing evicted before its first use counts as a miss
+  if (unused_.erase(path) > 0 && cached) {
+    ++hits_;
+  } else if (!cached) {
+    ++misses_;
+  }
+}
+
+PrefetchStats Prefetcher::stats() const {
+  return {.issued_ = issued_.load(),
+          .loaded_ = loaded_.load(),
+          .cancelled_ = cancelled_.load(),
+          .hits_ = hits_,
+          .misses_ = misses_};
+}
+
+} // namespace duck
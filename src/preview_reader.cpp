@@ -0,0 +1,231 @@
+#include "preview_reader.hpp"
+#include "byte_scan.hpp"
+#include <algorithm>
+#include <array>
+#include <fcntl.h>
+#include <span>
+#include <unistd.h>
+
+namespace duck {
+
+namespace {
+
+// First read, every following one is twice as large
+constexpr size_t preview_chunk_size = size_t{16} << 10U;
+constexpr size_t tab_width = 8;
+constexpr std::string_view ellipsis = "...";
+// Shown for control bytes and malformed UTF-8
+constexpr std::string_view replacement = "\xef\xbf\xbd";
+
+struct Interval {
+  char32_t first_;
+  char32_t last_;
+};
+
+constexpr std::array<Interval, 5> zero_width{{
+    {0x0300, 0x036f},
+    {0x200b, 0x200f},
+    {0x20d0, 0x20ff},
+    {0xfe00, 0xfe0f},
+    {0xfe20, 0xfe2f},
+}};
+
+constexpr std::array<Interval, 12> double_width{{
+    {0x1100, 0x115f},
+    {0x2e80, 0x303e},
+    {0x3041, 0x33ff},
+    {0x3400, 0x4dbf},
+    {0x4e00, 0x9fff},
+    {0xa000, 0xa4cf},
+    {0xac00, 0xd7a3},
+    {0xf900, 0xfaff},
+    {0xfe30, 0xfe4f},
+    {0xff00, 0xff60},
+    {0xffe0, 0xffe6},
+    {0x1f300, 0x1faff},
+}};
+
+bool in_intervals(std::span<const Interval> intervals, char32_t code_point) {
+  return std::ranges::any_of(intervals, [code_point](const Interval &range) {
+    return code_point >= range.first_ && code_point <= range.last_;
+  });
+}
+
+// Decodes the code point starting at `bytes[i]` and returns its length, or
+// 0 when the bytes there aren't well-formed UTF-8.
+size_t decode(std::string_view bytes, size_t i, char32_t &code_point) {
+  auto lead = static_cast<unsigned char>(bytes[i]);
+  size_t length = 0;
+  char32_t minimum = 0;
+  if (lead < 0x80) {
+    code_point = lead;
+    return 1;
+  }
+  if (lead >= 0xc2 && lead <= 0xdf) {
+    length = 2;
+    code_point = lead & 0x1fU;
+    minimum = 0x80;
+  } else if (lead >= 0xe0 && lead <= 0xef) {
+    length = 3;
+    code_point = lead & 0x0fU;
+    minimum = 0x800;
+  } else if (lead >= 0xf0 && lead <= 0xf4) {
+    length = 4;
+    code_point = lead & 0x07U;
+    minimum = 0x10000;
+  } else {
+    return 0;
+  }
+  if (bytes.size() - i < length) {
+    return 0;
+  }
+  for (size_t k = 1; k < length; ++k) {
+    auto byte = static_cast<unsigned char>(bytes[i + k]);
+    if ((byte & 0xc0U) != 0x80) {
+      return 0;
+    }
+    code_point = (code_point << 6U) | (byte & 0x3fU);
+  }
+  if (code_point < minimum || code_point > 0x10ffff ||
+      (code_point >= 0xd800 && code_point <= 0xdfff)) {
+    return 0;
+  }
+  return length;
+}
+
+// Appends `line` to `text`, expanding tabs and cutting it with an ellipsis
+// where it gets wider than `columns`.
+void append_line(std::string &text, std::string_view line, size_t columns) {
+  if (line.size() <= columns && is_printable_ascii(line)) {
+    text += line;
+    return;
+  }
+
+  auto limit = columns > ellipsis.size() ? columns - ellipsis.size() : 0;
+  // Output length while the line still fits in `limit`
+  auto cut = text.size();
+  size_t width = 0;
+  size_t i = 0;
+  while (i < line.size()) {
+    // Runs of printable ASCII are copied at once, one column per byte
+    auto run = i;
+    while (run < line.size() && run - i + width < columns &&
+           static_cast<unsigned char>(line[run]) - 0x20U < 0x5fU) {
+      ++run;
+    }
+    if (run != i) {
+      if (width < limit) {
+        cut = text.size() + std::min(run - i, limit - width);
+      }
+      text += line.substr(i, run - i);
+      width += run - i;
+      i = run;
+      continue;
+    }
+
+    char32_t code_point = 0;
+    auto length = decode(line, i, code_point);
+    auto is_tab = length != 0 && code_point == '\t';
+    auto printable = length != 0 && code_point >= 0x20 &&
+                     (code_point < 0x7f || code_point >= 0xa0);
+    auto step_width =
+        is_tab      ? tab_width - width % tab_width
+        : printable ? static_cast<size_t>(display_width(code_point))
+                    : 1;
+
+    if (width + step_width > columns) {
+      break;
+    }
+    if (is_tab) {
+      text.append(step_width, ' ');
+    } else if (printable) {
+      text += line.substr(i, length);
+    } else {
+      text += replacement;
+    }
+    width += step_width;
+    i += length == 0 ? 1 : length;
+    if (width <= limit) {
+      cut = text.size();
+    }
+  }
+  if (i < line.size()) {
+    text.resize(cut);
+    text += ellipsis;
+  }
+}
+
+} // namespace
+
+int display_width(char32_t code_point) {
+  if (code_point < zero_width.front().first_) {
+    return 1;
+  }
+  if (in_intervals(zero_width, code_point)) {
+    return 0;
+  }
+  if (in_intervals(double_width, code_point) ||
+      (code_point >= 0x20000 && code_point <= 0x3fffd)) {
+    return 2;
+  }
+  return 1;
+}
+
+TextLines split_lines(std::string_view bytes, size_t columns, size_t rows) {
+  TextLines lines;
+  lines.offsets_.reserve(rows + 1);
+  size_t start = 0;
+  while (lines.size() < rows && start < bytes.size()) {
+    auto end = find_byte(bytes, '\n', start);
+    auto line = bytes.substr(start, end - start);
+    if (line.ends_with('\r')) {
+      line.remove_suffix(1);
+    }
+    append_line(lines.text_, line, columns);
+    lines.offsets_.push_back(static_cast<std::uint32_t>(lines.text_.size()));
+    start = end + 1;
+  }
+  return lines;
+}
+
+std::optional<TextLines> read_preview(const fs::path &path, size_t columns,
+                                      size_t rows) {
+  auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+  if (fd == -1) {
+    return std::nullopt;
+  }
+
+  // Chunks are read until they hold `rows` lines. pread rather than mmap,
+  // since a mapped file truncated meanwhile would raise SIGBUS.
+  std::string buffer;
+  size_t newlines = 0;
+  auto failed = false;
+  auto chunk_size = preview_chunk_size;
+  while (buffer.size() < preview_window_size && newlines < rows) {
+    auto offset = buffer.size();
+    auto chunk = std::min(chunk_size, preview_window_size - offset);
+    chunk_size *= 2;
+    ssize_t count = 0;
+    buffer.resize_and_overwrite(offset + chunk, [&](char *data, size_t) {
+      count = pread(fd, data + offset, chunk, static_cast<off_t>(offset));
+      return offset + static_cast<size_t>(std::max<ssize_t>(count, 0));
+    });
+    if (count <= 0) {
+      failed = count < 0 && offset == 0;
+      break;
+    }
+    for (auto i = find_byte(buffer, '\n', offset);
+         i < buffer.size() && newlines < rows;
+         i = find_byte(buffer, '\n', i + 1)) {
+      ++newlines;
+    }
+  }
+  close(fd);
+
+  if (failed) {
+    return std::nullopt;
+  }
+  return split_lines(buffer, columns, rows);
+}
+
+} // namespace duck
@@ -10,4 +10,8 @@ exec::static_thread_pool::scheduler Scheduler::cpu_scheduler() {
   return cpu_pool_.get_scheduler();
 }
 
+exec::static_thread_pool::scheduler Scheduler::background_scheduler() {
+  return background_pool_.get_scheduler();
+}
+
 } // namespace duck
@@ -0,0 +1,311 @@
+#include "snapshot.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace duck {
+
+namespace {
+
+constexpr std::array<char, 8> snapshot_magic{'D', 'U', 'C', 'K',
+                                             'S', 'N', 'A', 'P'};
+constexpr std::uint32_t snapshot_version = 1;
+
+class SnapshotWriter {
+private:
+  std::string buffer_;
+
+public:
+  template <typename T> void value(const T &value) {
+    buffer_.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  template <typename T> void array(std::span<const T> values) {
+    value<std::uint64_t>(values.size());
+    buffer_.append(reinterpret_cast<const char *>(values.data()),
+                   values.size_bytes());
+  }
+
+  void string(std::string_view text) {
+    array(std::span<const char>{text.data(), text.size()});
+  }
+
+  [[nodiscard]] const std::string &buffer() const { return buffer_; }
+};
+
+// Bounds-checked reads out of the mapping. Values are copied out, so the
+// file needs no particular alignment.
+class SnapshotReader {
+private:
+  std::span<const std::byte> data_;
+  size_t offset_ = 0;
+
+public:
+  explicit SnapshotReader(std::span<const std::byte> data) : data_{data} {}
+
+  template <typename T> std::optional<T> value() {
+    if (data_.size() - offset_ < sizeof(T)) {
+      return std::nullopt;
+    }
+    T result;
+    std::memcpy(&result, data_.data() + offset_, sizeof(T));
+    offset_ += sizeof(T);
+    return result;
+  }
+
+  template <typename T, typename Container = std::vector<T>>
+  std::optional<Container> array() {
+    auto count = value<std::uint64_t>();
+    if (!count || count.value() > (data_.size() - offset_) / sizeof(T)) {
+      return std::nullopt;
+    }
+    Container result(count.value(), T{});
+    auto bytes = count.value() * sizeof(T);
+    std::memcpy(result.data(), data_.data() + offset_, bytes);
+    offset_ += bytes;
+    return result;
+  }
+
+  std::optional<std::string> string() { return array<char, std::string>(); }
+};
+
+void write_entry(SnapshotWriter &writer, const Entry &entry) {
+  writer.string(entry.path().native());
+  writer.value(static_cast<std::int8_t>(entry.type()));
+  writer.value(static_cast<std::uint8_t>(entry.is_symlink()));
+}
+
+std::optional<Entry> read_entry(SnapshotReader &reader) {
+  auto path = reader.string();
+  auto type = reader.value<std::int8_t>();
+  auto is_symlink = reader.value<std::uint8_t>();
+  if (!path || !type || !is_symlink) {
+    return std::nullopt;
+  }
+  return Entry{path.value(), static_cast<fs::file_type>(type.value()),
+               is_symlink.value() != 0};
+}
+
+void write_directory(SnapshotWriter &writer, const Directory &listing) {
+  // Rows left dead by removes and renames aren't saved
+  std::optional<Directory> live;
+  if (listing.table_.size() != listing.all_entries_.size()) {
+    live = listing;
+    live->drop_dead_rows();
+  }
+  const auto &directory = live ? live.value() : listing;
+  const auto &table = directory.table_;
+  const auto &stamp = directory.stamp_.value();
+  writer.string(directory.path_.native());
+  writer.value(stamp.inode_);
+  writer.value(stamp.mtime_);
+  writer.value(stamp.ctime_);
+  writer.value(static_cast<std::uint8_t>(directory.sort_mode_));
+  writer.string(table.name_arena());
+  writer.array(table.name_offsets());
+  writer.array(table.kinds());
+  writer.array(table.sizes());
+  writer.array(table.mtimes());
+  writer.array(std::span<const Row>{directory.entries_});
+  writer.array(std::span<const Row>{directory.hidden_entries_});
+}
+
+// Adds the next saved directory to `directories`, unless its columns don't
+// fit together. False if the data ends before the directory does.
+bool read_directory(SnapshotReader &reader,
+                    std::vector<DirectoryPtr> &directories) {
+  auto path = reader.string();
+  auto inode = reader.value<std::uint64_t>();
+  auto mtime = reader.value<std::int64_t>();
+  auto ctime = reader.value<std::int64_t>();
+  auto sort_mode = reader.value<std::uint8_t>();
+  auto names = reader.string();
+  auto name_offsets = reader.array<std::uint32_t>();
+  auto kinds = reader.array<std::uint8_t>();
+  auto sizes = reader.array<std::uint64_t>();
+  auto mtimes = reader.array<std::int64_t>();
+  auto entries = reader.array<Row>();
+  auto hidden_entries = reader.array<Row>();
+  if (!path || !inode || !mtime || !ctime || !sort_mode || !names ||
+      !name_offsets || !kinds || !sizes || !mtimes || !entries ||
+      !hidden_entries) {
+    return false;
+  }
+  if (sort_mode.value() >= sort_mode_count) {
+    return true;
+  }
+
+  auto table = DirectoryTable::from_columns(
+      std::move(names.value()), std::move(name_offsets.value()),
+      std::move(kinds.value()), std::move(sizes.value()),
+      std::move(mtimes.value()));
+  if (!table) {
+    return true;
+  }
+
+  auto rows = table.value().size();
+  auto in_range = [rows](Row row) { return row < rows; };
+  if (entries.value().size() + hidden_entries.value().size() != rows ||
+      !std::ranges::all_of(entries.value(), in_range) ||
+      !std::ranges::all_of(hidden_entries.value(), in_range)) {
+    return true;
+  }
+
+  // Rows were saved in order, only the keys and the merged view need
+  // rebuilding
+  auto mode = static_cast<SortMode>(sort_mode.value());
+  table.value().ensure_keys(mode);
+  Directory directory{.path_ = std::move(path.value()),
+                      .table_ = std::move(table.value()),
+                      .entries_ = std::move(entries.value()),
+                      .hidden_entries_ = std::move(hidden_entries.value()),
+                      .sort_mode_ = mode,
+                      .stamp_ = DirectoryStamp{.inode_ = inode.value(),
+                                               .mtime_ = mtime.value(),
+                                               .ctime_ = ctime.value()}};
+  directory.merge_hidden();
+  directories.push_back(
+      std::make_shared<const Directory>(std::move(directory)));
+  return true;
+}
+
+std::optional<Snapshot> parse_snapshot(std::span<const std::byte> data) {
+  SnapshotReader reader{data};
+  auto magic = reader.value<std::array<char, 8>>();
+  auto version = reader.value<std::uint32_t>();
+  auto directory_count = reader.value<std::uint32_t>();
+  if (!magic || magic.value() != snapshot_magic || !version ||
+      version.value() != snapshot_version || !directory_count) {
+    return std::nullopt;
+  }
+
+  Snapshot snapshot;
+  auto &session = snapshot.session_;
+  auto current_path = reader.string();
+  auto focused_name = reader.string();
+  auto index = reader.value<std::uint64_t>();
+  auto show_hidden = reader.value<std::uint8_t>();
+  auto sort_mode = reader.value<std::uint8_t>();
+  auto selected_count = reader.value<std::uint64_t>();
+  if (!current_path || !focused_name || !index || !show_hidden ||
+      !sort_mode || !selected_count || sort_mode.value() >= sort_mode_count) {
+    return std::nullopt;
+  }
+  session.current_path_ = std::move(current_path.value());
+  session.focused_name_ = std::move(focused_name.value());
+  session.index_ = index.value();
+  session.show_hidden_ = show_hidden.value() != 0;
+  session.sort_mode_ = static_cast<SortMode>(sort_mode.value());
+  for (std::uint64_t i = 0; i < selected_count.value(); ++i) {
+    auto entry = read_entry(reader);
+    if (!entry) {
+      return std::nullopt;
+    }
+    session.selected_.push_back(std::move(entry.value()));
+  }
+
+  // A directory that doesn't add up is left out, the rest still load
+  for (std::uint32_t i = 0; i < directory_count.value(); ++i) {
+    if (!read_directory(reader, snapshot.directories_)) {
+      return std::nullopt;
+    }
+  }
+  return snapshot;
+}
+
+} // namespace
+
+std::optional<fs::path> snapshot_path() {
+  if (const auto *cache_home = std::getenv("XDG_CACHE_HOME");
+      cache_home != nullptr && *cache_home != '\0') {
+    return fs::path{cache_home} / "duck" / "snapshot";
+  }
+  if (const auto *home = std::getenv("HOME"); home != nullptr) {
+    return fs::path{home} / ".cache" / "duck" / "snapshot";
+  }
+  return std::nullopt;
+}
+
+bool write_snapshot(const fs::path &file, const Snapshot &snapshot) {
+  std::vector<const Directory *> directories;
+  size_t rows = 0;
+  for (const auto &directory : snapshot.directories_) {
+    if (directories.size() == snapshot_max_directories) {
+      break;
+    }
+    auto live_rows = directory->all_entries_.size();
+    if (!directory->stamp_ || rows + live_rows > snapshot_max_rows) {
+      continue;
+    }
+    rows += live_rows;
+    directories.push_back(directory.get());
+  }
+
+  SnapshotWriter writer;
+  const auto &session = snapshot.session_;
+  writer.value(snapshot_magic);
+  writer.value(snapshot_version);
+  writer.value(static_cast<std::uint32_t>(directories.size()));
+  writer.string(session.current_path_.native());
+  writer.string(session.focused_name_);
+  writer.value(static_cast<std::uint64_t>(session.index_));
+  writer.value(static_cast<std::uint8_t>(session.show_hidden_));
+  writer.value(static_cast<std::uint8_t>(session.sort_mode_));
+  writer.value(static_cast<std::uint64_t>(session.selected_.size()));
+  for (const auto &entry : session.selected_) {
+    write_entry(writer, entry);
+  }
+  for (const auto *directory : directories) {
+    write_directory(writer, *directory);
+  }
+
+  std::error_code error;
+  fs::create_directories(file.parent_path(), error);
+  auto temporary = fs::path{file}.concat(".tmp");
+  {
+    std::ofstream out{temporary, std::ios::binary | std::ios::trunc};
+    out.write(writer.buffer().data(),
+              static_cast<std::streamsize>(writer.buffer().size()));
+    if (!out) {
+      fs::remove(temporary, error);
+      return false;
+    }
+  }
+  fs::rename(temporary, file, error);
+  return !error;
+}
+
+std::optional<Snapshot> read_snapshot(const fs::path &file) {
+  auto fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return std::nullopt;
+  }
+
+  struct stat st{};
+  if (fstat(fd, &st) == -1 || st.st_size == 0) {
+    close(fd);
+    return std::nullopt;
+  }
+  auto size = static_cast<size_t>(st.st_size);
+  auto *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return std::nullopt;
+  }
+
+  auto snapshot =
+      parse_snapshot({static_cast<const std::byte *>(data), size});
+  munmap(data, size);
+  return snapshot;
+}
+
+} // namespace duck
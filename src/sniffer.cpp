@@ -0,0 +1,239 @@
+#include "sniffer.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace duck {
+
+using namespace std::string_view_literals;
+
+namespace {
+
+constexpr size_t text_block_size = 16;
+
+struct Magic {
+  size_t offset_;
+  std::string_view bytes_;
+  ContentType type_;
+};
+
+constexpr std::array<Magic, 19> magics{{
+    {0, "\x89PNG\r\n\x1a\n"sv, ContentType::Png},
+    {0, "\xff\xd8\xff"sv, ContentType::Jpeg},
+    {0, "GIF87a"sv, ContentType::Gif},
+    {0, "GIF89a"sv, ContentType::Gif},
+    {0, "%PDF-"sv, ContentType::Pdf},
+    {0, "PK\x03\x04"sv, ContentType::Zip},
+    {0, "PK\x05\x06"sv, ContentType::Zip},
+    {0, "\x1f\x8b"sv, ContentType::Gzip},
+    {0, "BZh"sv, ContentType::Bzip2},
+    {0, "\xfd"
+        "7zXZ\0"sv,
+     ContentType::Xz},
+    {0, "\x28\xb5\x2f\xfd"sv, ContentType::Zstd},
+    {0, "7z\xbc\xaf\x27\x1c"sv, ContentType::SevenZip},
+    {0, "\x7f"
+        "ELF"sv,
+     ContentType::Elf},
+    {4, "ftyp"sv, ContentType::Mp4},
+    {0, "OggS"sv, ContentType::Ogg},
+    {0, "fLaC"sv, ContentType::Flac},
+    {0, "ID3"sv, ContentType::Mp3},
+    {0, "SQLite format 3\0"sv, ContentType::Sqlite},
+    {257, "ustar"sv, ContentType::Tar},
+}};
+
+// Indexed by ContentType
+constexpr std::array<std::string_view, 22> mimes{
+    "inode/x-unreadable",
+    "inode/x-empty",
+    "text/plain",
+    "application/octet-stream",
+    "image/png",
+    "image/jpeg",
+    "image/gif",
+    "image/x-portable-anymap",
+    "application/pdf",
+    "application/zip",
+    "application/gzip",
+    "application/x-bzip2",
+    "application/x-xz",
+    "application/zstd",
+    "application/x-7z-compressed",
+    "application/x-tar",
+    "application/x-executable",
+    "video/mp4",
+    "audio/ogg",
+    "audio/flac",
+    "audio/mpeg",
+    "application/vnd.sqlite3",
+};
+
+bool is_text_byte(unsigned char byte) {
+  return byte >= 0x20 || (byte >= 0x08 && byte <= 0x0d) || byte == 0x1b;
+}
+
+// Whether the block is ASCII text throughout. False only means the block
+// needs the byte by byte check, which also handles UTF-8.
+bool ascii_text_block(const unsigned char *data) {
+#if defined(__SSE2__)
+  auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+  // Signed compare: bytes from 0x80 up count as control bytes here too
+  auto control = _mm_cmplt_epi8(block, _mm_set1_epi8(0x20));
+  auto whitespace =
+      _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8(0x07)),
+                    _mm_cmplt_epi8(block, _mm_set1_epi8(0x0e)));
+  auto escape = _mm_cmpeq_epi8(block, _mm_set1_epi8(0x1b));
+  auto rejected =
+      _mm_andnot_si128(_mm_or_si128(whitespace, escape), control);
+  return _mm_movemask_epi8(rejected) == 0;
+#else
+  // Any byte with the high bit set or below 0x20, eight at a time
+  constexpr std::uint64_t ones = 0x0101010101010101ULL;
+  constexpr std::uint64_t high_bits = 0x8080808080808080ULL;
+  for (size_t i = 0; i < text_block_size; i += sizeof(std::uint64_t)) {
+    std::uint64_t word = 0;
+    std::memcpy(&word, data + i, sizeof(word));
+    if (((word | ((word - ones * 0x20) & ~word)) & high_bits) != 0) {
+      return false;
+    }
+  }
+  return true;
+#endif
+}
+
+// Length of the text character starting at `bytes[i]`, 0 when it is a
+// control byte or malformed UTF-8. A sequence cut off by the end of `bytes`
+// takes up the rest of it.
+size_t character_length(std::span<const unsigned char> bytes, size_t i) {
+  auto lead = bytes[i];
+  if (lead < 0x80) {
+    return is_text_byte(lead) ? 1 : 0;
+  }
+
+  // Lead byte ranges and the allowed range of the second byte, which rule
+  // out overlong forms, surrogates and code points past U+10FFFF
+  size_t length = 0;
+  unsigned char low = 0x80;
+  unsigned char high = 0xbf;
+  if (lead >= 0xc2 && lead <= 0xdf) {
+    length = 2;
+  } else if (lead == 0xe0) {
+    length = 3;
+    low = 0xa0;
+  } else if (lead == 0xed) {
+    length = 3;
+    high = 0x9f;
+  } else if (lead >= 0xe1 && lead <= 0xef) {
+    length = 3;
+  } else if (lead == 0xf0) {
+    length = 4;
+    low = 0x90;
+  } else if (lead >= 0xf1 && lead <= 0xf3) {
+    length = 4;
+  } else if (lead == 0xf4) {
+    length = 4;
+    high = 0x8f;
+  } else {
+    return 0;
+  }
+
+  for (size_t k = 1; k < length; ++k) {
+    if (i + k == bytes.size()) {
+      return k;
+    }
+    auto byte = bytes[i + k];
+    if (byte < (k == 1 ? low : 0x80) || byte > (k == 1 ? high : 0xbf)) {
+      return 0;
+    }
+  }
+  return length;
+}
+
+// P1 to P7 followed by whitespace
+bool is_netpbm(std::span<const unsigned char> head) {
+  return head.size() >= 3 && head[0] == 'P' && head[1] >= '1' &&
+         head[1] <= '7' &&
+         (head[2] == ' ' || head[2] == '\n' || head[2] == '\r' ||
+          head[2] == '\t');
+}
+
+} // namespace
+
+std::string_view content_mime(ContentType type) {
+  return mimes[static_cast<size_t>(type)];
+}
+
+bool is_text(std::span<const unsigned char> bytes) {
+  size_t i = 0;
+  while (i < bytes.size()) {
+    if (bytes.size() - i >= text_block_size &&
+        ascii_text_block(bytes.data() + i)) {
+      i += text_block_size;
+      continue;
+    }
+    auto end = std::min(i + text_block_size, bytes.size());
+    while (i < end) {
+      auto length = character_length(bytes, i);
+      if (length == 0) {
+        return false;
+      }
+      i += length;
+    }
+  }
+  return true;
+}
+
+ContentType sniff_bytes(std::span<const unsigned char> head) {
+  if (head.empty()) {
+    return ContentType::Empty;
+  }
+  for (const auto &magic : magics) {
+    if (head.size() >= magic.offset_ + magic.bytes_.size() &&
+        std::memcmp(head.data() + magic.offset_, magic.bytes_.data(),
+                    magic.bytes_.size()) == 0) {
+      return magic.type_;
+    }
+  }
+  if (is_netpbm(head)) {
+    return ContentType::Netpbm;
+  }
+  return is_text(head) ? ContentType::Text : ContentType::Binary;
+}
+
+ContentType ContentSniffer::sniff(const fs::path &path) {
+  // Non-blocking so that opening a FIFO can't hang a worker
+  auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+  if (fd == -1) {
+    return ContentType::Unreadable;
+  }
+
+  auto identity = identify_file(fd);
+  if (identity) {
+    if (auto cached = cache_.get(identity.value())) {
+      close(fd);
+      return cached.value();
+    }
+  }
+
+  std::array<unsigned char, sniff_head_size> head{};
+  auto count = pread(fd, head.data(), head.size(), 0);
+  close(fd);
+  if (count < 0) {
+    return ContentType::Unreadable;
+  }
+
+  auto type = sniff_bytes({head.data(), static_cast<size_t>(count)});
+  if (identity) {
+    cache_.insert(identity.value(), type);
+  }
+  return type;
+}
+
+} // namespace duck
@@ -3,6 +3,7 @@
 #include "app_state.hpp"
 #include "ftxui/dom/elements.hpp"
 #include "input_handler.hpp"
+#include <algorithm>
 #include <cstddef>
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/component_base.hpp>
@@ -31,6 +32,10 @@ Ui::Ui(InputHandler &input_handler)
       content_provider_.creation_dialog(cursor_positon_, input_content_) |
       ftxui::CatchEvent(input_handler_.creation_dialog_handler());
 
+  jump_dialog_ =
+      content_provider_.jump_dialog(cursor_positon_, input_content_) |
+      ftxui::CatchEvent(input_handler_.jump_dialog_handler());
+
   deletion_dialog_ =
       content_provider_.deletion_dialog(
           selected_entries_,
@@ -80,6 +85,7 @@ void Ui::finalize_tui() {
           rename_dialog_,
           creation_dialog_,
           notification_,
+          jump_dialog_,
       },
       &active_pane_);
   main_layout_->TakeFocus();
@@ -114,6 +120,14 @@ void Ui::finalize_tui() {
       });
     }
 
+    case static_cast<int>(pane::JUMP): {
+      return ftxui::dbox({
+          main_ui_layer,
+          ftxui::filler(),
+          jump_dialog_->Render() | ftxui::center,
+      });
+    }
+
     case static_cast<int>(pane::NOTIFICATION): {
 
       auto top_layer = ftxui::hbox(
@@ -175,6 +189,21 @@ void Ui::async_toggle_creation_dialog() {
   screen_.PostEvent(ftxui::Event::Custom);
 }
 
+void Ui::async_toggle_jump_dialog() {
+  screen_.Post([this]() {
+    if (active_pane_ == static_cast<int>(pane::JUMP)) {
+      active_pane_ = static_cast<int>(pane::MAIN);
+      input_content_ = "";
+      cursor_positon_ = 0;
+      main_layout_->TakeFocus();
+    } else if (active_pane_ == static_cast<int>(pane::MAIN)) {
+      active_pane_ = static_cast<int>(pane::JUMP);
+      jump_dialog_->TakeFocus();
+    }
+  });
+  screen_.PostEvent(ftxui::Event::Custom);
+}
+
 void Ui::async_toggle_notification() {
   screen_.Post([this]() {
     if (active_pane_ == static_cast<int>(pane::NOTIFICATION)) {
@@ -203,8 +232,8 @@ std::string &Ui::input_content() { return input_content_; }
 int &Ui ::cursor_positon() { return cursor_positon_; }
 
 void Ui::run(AppState &state) {
-  info_ = {state.current_directory_.path_.string(), state.index_,
-           state.current_directory_elements()};
+  info_ = {state.current_path_.string(), state.index_,
+           state.current_rows()};
   preview_ = ftxui::text("");
   selected_entries_ = ftxui::text("");
   screen_.Loop(tui_);
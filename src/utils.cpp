@@ -0,0 +1,216 @@
+#include "utils.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <iterator>
+#include <numeric>
+#include <sys/stat.h>
+
+namespace duck {
+
+std::optional<DirectoryStamp> stamp_directory(const fs::path &path) {
+  struct statx stx{};
+  if (statx(AT_FDCWD, path.c_str(), AT_STATX_SYNC_AS_STAT,
+            STATX_INO | STATX_MTIME | STATX_CTIME, &stx) == -1) {
+    return std::nullopt;
+  }
+  auto nanoseconds = [](const statx_timestamp &time) {
+    return time.tv_sec * 1'000'000'000 + time.tv_nsec;
+  };
+  return DirectoryStamp{.inode_ = stx.stx_ino,
+                        .mtime_ = nanoseconds(stx.stx_mtime),
+                        .ctime_ = nanoseconds(stx.stx_ctime)};
+}
+
+namespace {
+
+FileIdentity to_identity(const struct stat &st) {
+  return FileIdentity{.device_ = st.st_dev,
+                      .inode_ = st.st_ino,
+                      .mtime_ = st.st_mtim.tv_sec * 1'000'000'000 +
+                                st.st_mtim.tv_nsec,
+                      .size_ = static_cast<std::uint64_t>(st.st_size)};
+}
+
+} // namespace
+
+std::optional<FileIdentity> identify_file(int fd) {
+  struct stat st{};
+  if (fstat(fd, &st) == -1) {
+    return std::nullopt;
+  }
+  return to_identity(st);
+}
+
+std::optional<FileIdentity> identify_path(const fs::path &path) {
+  struct stat st{};
+  if (stat(path.c_str(), &st) == -1) {
+    return std::nullopt;
+  }
+  return to_identity(st);
+}
+
+Entry Directory::entry(Row row) const {
+  return {path_ / table_.name(row), table_.type(row), table_.is_symlink(row)};
+}
+
+std::optional<Row> Directory::find(std::string_view name) const {
+  for (const auto *rows : {&entries_, &hidden_entries_}) {
+    auto it = std::ranges::find(*rows, name,
+                                [this](Row row) { return table_.name(row); });
+    if (it != rows->end()) {
+      return *it;
+    }
+  }
+  return std::nullopt;
+}
+
+Row Directory::add_entry(std::string_view name, fs::file_type type,
+                         bool is_symlink) {
+  auto row = table_.append(name, type, is_symlink);
+  if (table_.is_hidden(row)) {
+    hidden_entries_.push_back(row);
+  } else {
+    entries_.push_back(row);
+  }
+  all_entries_.push_back(row);
+  return row;
+}
+
+Row Directory::insert_entry(std::string_view name, fs::file_type type,
+                            bool is_symlink) {
+  auto row = table_.append(name, type, is_symlink);
+  table_.insert_sorted(table_.is_hidden(row) ? hidden_entries_ : entries_,
+                       row, sort_mode_);
+  table_.insert_sorted(all_entries_, row, sort_mode_);
+  return row;
+}
+
+std::optional<Row> Directory::rename_entry(std::string_view old_name,
+                                           std::string_view new_name) {
+  auto old_row = find(old_name);
+  if (!old_row) {
+    return std::nullopt;
+  }
+
+  // Taken first: removing may compact the table and renumber old_row
+  auto type = table_.type(old_row.value());
+  auto is_symlink = table_.is_symlink(old_row.value());
+  auto metadata = table_.has_metadata()
+                      ? std::optional{std::pair{
+                            table_.file_size(old_row.value()),
+                            table_.mtime(old_row.value())}}
+                      : std::nullopt;
+  remove_entry(old_name);
+  remove_entry(new_name);
+  auto row = table_.append(new_name, type, is_symlink);
+  if (metadata) {
+    table_.set_metadata(row, metadata->first, metadata->second);
+  }
+  table_.insert_sorted(table_.is_hidden(row) ? hidden_entries_ : entries_,
+                       row, sort_mode_);
+  table_.insert_sorted(all_entries_, row, sort_mode_);
+  if (compact()) {
+    return find(new_name);
+  }
+  return row;
+}
+
+void Directory::set_metadata(Row row, std::uint64_t size_bytes,
+                             std::int64_t mtime_ns) {
+  table_.set_metadata(row, size_bytes, mtime_ns);
+  if (!needs_metadata(sort_mode_)) {
+    return;
+  }
+  for (auto *rows :
+       {table_.is_hidden(row) ? &hidden_entries_ : &entries_, &all_entries_}) {
+    if (std::erase(*rows, row) > 0) {
+      table_.insert_sorted(*rows, row, sort_mode_);
+    }
+  }
+}
+
+void Directory::remove_entry(std::string_view name) {
+  auto pred = [this, name](Row row) { return table_.name(row) == name; };
+  std::erase_if(entries_, pred);
+  std::erase_if(hidden_entries_, pred);
+  std::erase_if(all_entries_, pred);
+  compact();
+}
+
+bool Directory::compact() {
+  auto dead = table_.size() - all_entries_.size();
+  if (dead * dead_row_share <= table_.size()) {
+    return false;
+  }
+  drop_dead_rows();
+  return true;
+}
+
+// all_entries_ holds every live row, so the new table takes them in its
+// order and all_entries_ becomes 0, 1, 2...
+void Directory::drop_dead_rows() {
+  std::vector<Row> renumbered(table_.size());
+  for (size_t i = 0; i < all_entries_.size(); ++i) {
+    renumbered[all_entries_[i]] = static_cast<Row>(i);
+  }
+  table_ = table_.select(all_entries_);
+  for (auto *rows : {&entries_, &hidden_entries_}) {
+    for (auto &row : *rows) {
+      row = renumbered[row];
+    }
+  }
+  std::iota(all_entries_.begin(), all_entries_.end(), Row{0});
+}
+
+void Directory::merge(const DirectoryTable &chunk) {
+  auto sorted_size = entries_.size();
+  auto sorted_hidden_size = hidden_entries_.size();
+  for (Row row = 0; row < chunk.size(); ++row) {
+    auto added =
+        add_entry(chunk.name(row), chunk.type(row), chunk.is_symlink(row));
+    if (chunk.has_metadata()) {
+      table_.set_metadata(added, chunk.file_size(row), chunk.mtime(row));
+    }
+  }
+
+  auto merge_tail = [this](std::vector<Row> &rows, size_t size) {
+    auto middle = rows.begin() + static_cast<std::ptrdiff_t>(size);
+    table_.sort({middle, rows.end()}, sort_mode_);
+    std::ranges::inplace_merge(rows, middle, [this](Row first, Row second) {
+      return less(first, second);
+    });
+  };
+  merge_tail(entries_, sorted_size);
+  merge_tail(hidden_entries_, sorted_hidden_size);
+  merge_hidden();
+}
+
+void Directory::sort() {
+  table_.sort(entries_, sort_mode_);
+  table_.sort(hidden_entries_, sort_mode_);
+  merge_hidden();
+}
+
+// Rebuilds all_entries_ from the two sorted lists in linear time
+void Directory::merge_hidden() {
+  all_entries_.clear();
+  all_entries_.reserve(entries_.size() + hidden_entries_.size());
+  std::ranges::merge(
+      entries_, hidden_entries_, std::back_inserter(all_entries_),
+      [this](Row first, Row second) { return less(first, second); });
+}
+
+void Directory::set_sort_mode(SortMode mode) {
+  sort_mode_ = mode;
+  table_.ensure_keys(mode);
+  sort();
+}
+
+size_t Directory::memory_bytes() const {
+  return sizeof(*this) + path_.native().capacity() + table_.memory_bytes() +
+         (entries_.capacity() + hidden_entries_.capacity() +
+          all_entries_.capacity()) *
+             sizeof(Row);
+}
+
+} // namespace duck
@@ -0,0 +1,252 @@
+#include "watcher.hpp"
+#include "dir_reader.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace duck {
+
+namespace {
+
+constexpr std::uint32_t watch_mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                     IN_MOVED_TO | IN_CLOSE_WRITE |
+                                     IN_ONLYDIR;
+constexpr int idle_poll_ms = 100;
+constexpr size_t event_buffer_size = 64 * 1024;
+
+void stat_entry(const fs::path &path, FsChange &change) {
+  struct stat st{};
+  if (lstat(path.c_str(), &st) == -1) {
+    change.file_type_ = fs::file_type::not_found;
+    return;
+  }
+  if (S_ISLNK(st.st_mode)) {
+    change.is_symlink_ = true;
+    if (stat(path.c_str(), &st) == -1) {
+      change.file_type_ = fs::file_type::not_found;
+      return;
+    }
+  }
+  change.file_type_ = mode_to_type(st.st_mode);
+  change.size_ = static_cast<std::uint64_t>(st.st_size);
+  change.mtime_ = st.st_mtim.tv_sec * 1'000'000'000 + st.st_mtim.tv_nsec;
+}
+
+// Changes collected since the last flush, grouped per directory in the order
+// the directories first changed.
+class PendingChanges {
+private:
+  std::vector<DirectoryChanged> batches_;
+  // MOVED_FROM cookie -> (batch, change) of the Deleted placeholder
+  std::unordered_map<std::uint32_t, std::pair<size_t, size_t>> moves_;
+  bool overflow_ = false;
+
+  size_t batch_index(const fs::path &path) {
+    auto it = std::ranges::find(batches_, path, &DirectoryChanged::path_);
+    if (it == batches_.end()) {
+      batches_.push_back(DirectoryChanged{.path_ = path});
+      return batches_.size() - 1;
+    }
+    return static_cast<size_t>(std::distance(batches_.begin(), it));
+  }
+
+public:
+  [[nodiscard]] bool empty() const { return batches_.empty() && !overflow_; }
+
+  void add(const fs::path &path, const inotify_event &event) {
+    std::string name{event.name};
+    auto index = batch_index(path);
+    auto &changes = batches_[index].changes_;
+
+    if ((event.mask & IN_MOVED_FROM) != 0) {
+      // Deleted until a matching MOVED_TO turns it into a rename
+      moves_[event.cookie] = {index, changes.size()};
+      changes.push_back(
+          {.type_ = FsChange::Type::Deleted, .name_ = std::move(name)});
+      return;
+    }
+
+    if ((event.mask & IN_DELETE) != 0) {
+      changes.push_back(
+          {.type_ = FsChange::Type::Deleted, .name_ = std::move(name)});
+      return;
+    }
+
+    if ((event.mask & IN_MOVED_TO) != 0) {
+      if (auto it = moves_.find(event.cookie); it != moves_.end()) {
+        auto [from_batch, from_change] = it->second;
+        moves_.erase(it);
+        if (batches_[from_batch].path_ == path) {
+          auto &moved = batches_[from_batch].changes_[from_change];
+          moved.type_ = FsChange::Type::Renamed;
+          moved.new_name_ = std::move(name);
+          stat_entry(path / moved.new_name_, moved);
+          return;
+        }
+      }
+    }
+
+    FsChange change{.type_ = (event.mask & IN_CLOSE_WRITE) != 0
+                                 ? FsChange::Type::Modified
+                                 : FsChange::Type::Created,
+                    .name_ = std::move(name)};
+    stat_entry(path / change.name_, change);
+    changes.push_back(std::move(change));
+  }
+
+  void set_overflow() { overflow_ = true; }
+
+  void flush(EventBus &event_bus, const std::vector<fs::path> &watched) {
+    if (overflow_) {
+      for (const auto &path : watched) {
+        event_bus.push_event(
+            DirectoryChanged{.path_ = path, .overflow_ = true});
+      }
+    } else {
+      for (auto &batch : batches_) {
+        batch.stamp_ = stamp_directory(batch.path_);
+        event_bus.push_event(std::move(batch));
+      }
+    }
+    batches_.clear();
+    moves_.clear();
+    overflow_ = false;
+  }
+};
+
+} // namespace
+
+Watcher::Watcher(EventBus &event_bus)
+    : event_bus_{event_bus}, fd_{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)} {
+  if (fd_ != -1) {
+    watcher_thread_ =
+        std::jthread([this](const std::stop_token &stop) { run(stop); });
+  }
+}
+
+Watcher::~Watcher() {
+  if (watcher_thread_.joinable()) {
+    watcher_thread_.request_stop();
+    watcher_thread_.join();
+  }
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+void Watcher::watch(const std::vector<fs::path> &paths) {
+  if (fd_ == -1) {
+    return;
+  }
+
+  std::lock_guard lock{mutex_};
+  for (auto it = descriptors_.begin(); it != descriptors_.end();) {
+    if (std::ranges::find(paths, it->first) == paths.end()) {
+      inotify_rm_watch(fd_, it->second);
+      paths_.erase(it->second);
+      it = descriptors_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  for (const auto &path : paths) {
+    if (descriptors_.size() >= max_watched_directories) {
+      break;
+    }
+    if (descriptors_.contains(path)) {
+      continue;
+    }
+    auto descriptor = inotify_add_watch(fd_, path.c_str(), watch_mask);
+    if (descriptor != -1) {
+      descriptors_[path] = descriptor;
+      paths_[descriptor] = path;
+    }
+  }
+}
+
+std::vector<fs::path> Watcher::watched() {
+  std::lock_guard lock{mutex_};
+  std::vector<fs::path> paths;
+  paths.reserve(descriptors_.size());
+  for (const auto &[path, descriptor] : descriptors_) {
+    paths.push_back(path);
+  }
+  return paths;
+}
+
+std::optional<fs::path> Watcher::watched_path(int descriptor) {
+  std::lock_guard lock{mutex_};
+  if (auto it = paths_.find(descriptor); it != paths_.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+void Watcher::run(const std::stop_token &stop) {
+  alignas(inotify_event) std::array<char, event_buffer_size> buffer{};
+  PendingChanges pending;
+  auto first_change = std::chrono::steady_clock::time_point{};
+
+  while (!stop.stop_requested()) {
+    auto timeout = pending.empty()
+                       ? idle_poll_ms
+                       : static_cast<int>(watcher_debounce.count());
+    pollfd poll_fd{.fd = fd_, .events = POLLIN, .revents = 0};
+    auto ready = poll(&poll_fd, 1, timeout);
+    if (ready == -1 && errno != EINTR) {
+      return;
+    }
+
+    if (ready > 0) {
+      if (pending.empty()) {
+        first_change = std::chrono::steady_clock::now();
+      }
+      ssize_t length = 0;
+      while ((length = read(fd_, buffer.data(), buffer.size())) > 0) {
+        for (ssize_t offset = 0; offset < length;) {
+          const auto *event =
+              reinterpret_cast<const inotify_event *>(buffer.data() + offset);
+          offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+          if ((event->mask & IN_Q_OVERFLOW) != 0) {
+            pending.set_overflow();
+            continue;
+          }
+          if ((event->mask & IN_IGNORED) != 0) {
+            std::lock_guard lock{mutex_};
+            if (auto it = paths_.find(event->wd); it != paths_.end()) {
+              descriptors_.erase(it->second);
+              paths_.erase(it);
+            }
+            continue;
+          }
+          if (event->len == 0) {
+            continue;
+          }
+          if (auto path = watched_path(event->wd)) {
+            pending.add(path.value(), *event);
+          }
+        }
+      }
+    }
+
+    // Flush once the burst settles, or periodically while it keeps going
+    auto settled = ready == 0;
+    auto overdue =
+        std::chrono::steady_clock::now() - first_change >= watcher_max_latency;
+    if (!pending.empty() && (settled || overdue)) {
+      pending.flush(event_bus_, watched());
+    }
+  }
+}
+
+} // namespace duck
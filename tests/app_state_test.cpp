@@ -0,0 +1,34 @@
+#include "app_state.hpp"
+#include "doctest.h"
+#include "file_manager.hpp"
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+TEST_CASE("App State") {
+  auto root = fs::temp_directory_path() / "duck_app_state_test";
+  fs::remove_all(root);
+  fs::create_directories(root);
+  std::ofstream(root / "a_file").close();
+  std::ofstream(root / "b_file").close();
+  duck::AppState state;
+
+  SUBCASE("A load cancelled partway is reloaded") {
+    // Only the first chunk arrived before the load was cancelled
+    state.cache_directory(duck::Directory{.path_ = root, .partial_ = true});
+    duck::DirectoryTable chunk;
+    chunk.append("a_file", fs::file_type::regular, false);
+    state.merge_entries(root, chunk);
+    CHECK(state.entries_size(root) == 1);
+    CHECK(state.is_stale(root));
+    CHECK(state.is_stale(root));
+
+    state.commit_directory(
+        duck::FileManager::load_directory(root, duck::SortMode::Name));
+    CHECK(state.entries_size(root) == 2);
+    CHECK_FALSE(state.is_stale(root));
+  }
+
+  fs::remove_all(root);
+}
@@ -0,0 +1,168 @@
+#include "archive_lister.hpp"
+#include "doctest.h"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <zlib.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void append_le(std::string &out, std::uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; ++i) {
+    out += static_cast<char>((value >> (i * 8)) & 0xffU);
+  }
+}
+
+// Central directory entry; `size` 0xffffffff moves `size64` to zip64 extra
+std::string zip_entry(std::string_view name, std::uint32_t size,
+                      std::uint64_t size64 = 0) {
+  std::string extra;
+  if (size == 0xffffffff) {
+    append_le(extra, 0x0001, 2);
+    append_le(extra, 8, 2);
+    append_le(extra, size64, 8);
+  }
+  std::string entry;
+  append_le(entry, 0x02014b50, 4);
+  entry.append(16, '\0');
+  append_le(entry, size, 4);
+  append_le(entry, size, 4);
+  append_le(entry, name.size(), 2);
+  append_le(entry, extra.size(), 2);
+  entry.append(14, '\0');
+  return entry + std::string{name} + extra;
+}
+
+// Octal with a NUL at the end of the field
+void tar_octal(std::string &header, size_t offset, size_t width,
+               std::uint64_t value) {
+  for (size_t i = width - 1; i-- > 0;) {
+    header[offset + i] = static_cast<char>('0' + (value % 8));
+    value /= 8;
+  }
+  header[offset + width - 1] = '\0';
+}
+
+std::string tar_entry(std::string_view name, std::string_view payload,
+                      char type) {
+  std::string header(512, '\0');
+  header.replace(0, name.size(), name);
+  tar_octal(header, 100, 8, 0644);
+  tar_octal(header, 124, 12, payload.size());
+  header[156] = type;
+  header.replace(257, 5, "ustar");
+  header.replace(148, 8, 8, ' ');
+  std::uint64_t sum = 0;
+  for (auto c : header) {
+    sum += static_cast<unsigned char>(c);
+  }
+  tar_octal(header, 148, 8, sum);
+  std::string padding((512 - (payload.size() % 512)) % 512, '\0');
+  return header + std::string{payload} + padding;
+}
+
+void write_file(const fs::path &path, std::string_view bytes) {
+  std::ofstream{path, std::ios::binary}.write(bytes.data(),
+                                              std::ssize(bytes));
+}
+
+void write_gzip(const fs::path &path, std::string_view bytes) {
+  auto *file = gzopen(path.c_str(), "wb");
+  gzwrite(file, bytes.data(), static_cast<unsigned>(bytes.size()));
+  gzclose(file);
+}
+
+} // namespace
+
+TEST_CASE("Archive Lister") {
+  auto root = fs::temp_directory_path() / "duck_archive_lister_test";
+  fs::create_directories(root);
+  auto never = []() { return false; };
+
+  SUBCASE("Zip central directory") {
+    // Local headers and data, never read
+    std::string zip(100, 'x');
+    auto directory = zip_entry("a.txt", 5) + zip_entry("dir/", 0) +
+                     zip_entry("big.bin", 0xffffffff, 5ULL << 30U);
+    std::string end;
+    append_le(end, 0x06054b50, 4);
+    end.append(4, '\0');
+    append_le(end, 3, 2);
+    append_le(end, 3, 2);
+    append_le(end, directory.size(), 4);
+    append_le(end, zip.size(), 4);
+    // A comment holding a signature of its own
+    std::string comment{"PK\x05\x06 comment"};
+    append_le(end, comment.size(), 2);
+    write_file(root / "a.zip", zip + directory + end + comment);
+
+    auto listing = duck::list_zip(root / "a.zip", 10, never);
+    REQUIRE(listing);
+    CHECK(listing->total_ == 3);
+    REQUIRE(listing->entries_.size() == 3);
+    CHECK(listing->entries_[0].name_ == "a.txt");
+    CHECK(listing->entries_[0].size_ == 5);
+    CHECK(listing->entries_[1].is_directory_);
+    CHECK(listing->entries_[2].size_ == 5ULL << 30U);
+    CHECK(duck::list_zip(root / "a.zip", 2, never)->entries_.size() == 2);
+
+    auto lines = duck::archive_lines(listing.value(), 80, 10);
+    REQUIRE(lines.size() == 4);
+    CHECK(lines.line(0) == "3 entries");
+    CHECK(lines.line(1) == "     5  a.txt");
+    CHECK(lines.line(2) == "        dir/");
+    CHECK(lines.line(3) == "  5.0G  big.bin");
+
+    write_file(root / "broken.zip", zip + end);
+    CHECK_FALSE(duck::list_zip(root / "broken.zip", 10, never));
+  }
+
+  SUBCASE("Tar headers") {
+    std::string long_name(150, 'n');
+    auto tar = tar_entry("hello.txt", std::string(600, 'h'), '0') +
+               tar_entry("sub", "", '5') +
+               tar_entry("././@LongLink", long_name + '\0', 'L') +
+               tar_entry(long_name.substr(0, 99), "x", '0') +
+               std::string(1024, '\0');
+    write_file(root / "a.tar", tar);
+    write_gzip(root / "a.tar.gz", tar);
+
+    for (auto gzipped : {false, true}) {
+      auto path = root / (gzipped ? "a.tar.gz" : "a.tar");
+      auto listing = duck::list_tar(path, gzipped, 10, never);
+      REQUIRE(listing);
+      CHECK(listing->total_ == 3);
+      REQUIRE(listing->entries_.size() == 3);
+      CHECK(listing->entries_[0].name_ == "hello.txt");
+      CHECK(listing->entries_[0].size_ == 600);
+      CHECK(listing->entries_[1].name_ == "sub/");
+      CHECK(listing->entries_[1].is_directory_);
+      CHECK(listing->entries_[2].name_ == long_name);
+      CHECK(listing->entries_[2].size_ == 1);
+
+      auto first = duck::list_tar(path, gzipped, 1, never);
+      REQUIRE(first);
+      CHECK_FALSE(first->total_);
+      CHECK(duck::archive_lines(first.value(), 80, 10).line(0) ==
+            "1 entry or more");
+    }
+
+    // Cut inside the long name: the entries before it still show
+    write_file(root / "cut.tar", std::string_view{tar}.substr(0, 2300));
+    auto cut = duck::list_tar(root / "cut.tar", false, 10, never);
+    REQUIRE(cut);
+    CHECK(cut->entries_.size() == 2);
+
+    write_gzip(root / "text.gz", std::string(2048, 't'));
+    CHECK_FALSE(duck::list_archive(root / "text.gz", duck::ContentType::Gzip,
+                                   10, never));
+    CHECK_FALSE(duck::list_tar(root / "a.tar", false, 10,
+                               []() { return true; }));
+  }
+
+  fs::remove_all(root);
+}
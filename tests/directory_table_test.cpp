@@ -0,0 +1,256 @@
+#include "directory_table.hpp"
+#include "doctest.h"
+#include "utils.hpp"
+#include <algorithm>
+#include <string>
+
+namespace fs = std::filesystem;
+
+TEST_CASE("Directory Table") {
+  duck::DirectoryTable table;
+  auto file = table.append("notes.txt", fs::file_type::regular);
+  auto hidden = table.append(".config", fs::file_type::directory);
+  auto link = table.append("latest", fs::file_type::not_found, true);
+
+  SUBCASE("Names and kinds") {
+    CHECK(table.size() == 3);
+    CHECK(table.name(file) == "notes.txt");
+    CHECK(table.name(hidden) == ".config");
+    CHECK(table.is_hidden(hidden));
+    CHECK(table.is_directory(hidden));
+    CHECK_FALSE(table.is_hidden(file));
+    CHECK(table.type(link) == fs::file_type::not_found);
+    CHECK(table.is_symlink(link));
+    CHECK_FALSE(table.entry(link).exists());
+  }
+
+  SUBCASE("Metadata is optional") {
+    CHECK_FALSE(table.has_metadata());
+    table.set_metadata(file, 42, 7);
+    CHECK(table.has_metadata());
+    CHECK(table.file_size(file) == 42);
+    CHECK(table.mtime(file) == 7);
+    CHECK(table.file_size(hidden) == 0);
+  }
+}
+
+TEST_CASE("Directory") {
+  duck::Directory directory{.path_ = "/tmp"};
+  directory.add_entry("b", fs::file_type::regular);
+  directory.add_entry("a_dir", fs::file_type::directory);
+  directory.add_entry(".hidden", fs::file_type::regular);
+  directory.sort();
+
+  auto names = [&directory](const std::vector<duck::Row> &rows) {
+    std::vector<std::string_view> result;
+    for (auto entry : directory.table_.entries(rows)) {
+      result.push_back(entry.name());
+    }
+    return result;
+  };
+
+  SUBCASE("Insert keeps order") {
+    directory.insert_entry("a", fs::file_type::regular);
+    CHECK(names(directory.entries_) ==
+          std::vector<std::string_view>{"a_dir", "a", "b"});
+    CHECK(names(directory.hidden_entries_) ==
+          std::vector<std::string_view>{".hidden"});
+    CHECK(names(directory.all_entries_) ==
+          std::vector<std::string_view>{"a_dir", ".hidden", "a", "b"});
+  }
+
+  SUBCASE("Merge chunk") {
+    duck::DirectoryTable chunk;
+    chunk.append("c", fs::file_type::regular);
+    chunk.append("0_dir", fs::file_type::directory);
+    directory.merge(chunk);
+    CHECK(names(directory.entries_) ==
+          std::vector<std::string_view>{"0_dir", "a_dir", "b", "c"});
+    CHECK(names(directory.all_entries_) ==
+          std::vector<std::string_view>{"0_dir", "a_dir", ".hidden", "b",
+                                        "c"});
+  }
+
+  SUBCASE("Merge chunk with metadata") {
+    directory.set_metadata(directory.find("b").value(), 20, 0);
+    directory.set_sort_mode(duck::SortMode::Size);
+    duck::DirectoryTable chunk;
+    chunk.set_metadata(chunk.append("c", fs::file_type::regular), 30, 0);
+    chunk.set_metadata(chunk.append("d", fs::file_type::regular), 10, 0);
+    directory.merge(chunk);
+    CHECK(directory.table_.file_size(directory.find("c").value()) == 30);
+    CHECK(names(directory.entries_) ==
+          std::vector<std::string_view>{"a_dir", "d", "b", "c"});
+  }
+
+  SUBCASE("Remove and find") {
+    directory.remove_entry("b");
+    CHECK_FALSE(directory.find("b").has_value());
+    CHECK(directory.rows(true).size() == 2);
+    REQUIRE(directory.find(".hidden").has_value());
+    CHECK(directory.entry(directory.find(".hidden").value()).path() ==
+          "/tmp/.hidden");
+  }
+
+  SUBCASE("Rename keeps type and moves between lists") {
+    auto row = directory.rename_entry("a_dir", ".a_dir");
+    REQUIRE(row.has_value());
+    CHECK(directory.table_.is_directory(row.value()));
+    CHECK(names(directory.entries_) == std::vector<std::string_view>{"b"});
+    CHECK(names(directory.hidden_entries_) ==
+          std::vector<std::string_view>{".a_dir", ".hidden"});
+    CHECK(names(directory.all_entries_) ==
+          std::vector<std::string_view>{".a_dir", ".hidden", "b"});
+    CHECK_FALSE(directory.rename_entry("missing", "c").has_value());
+  }
+
+  SUBCASE("Dead rows are compacted") {
+    directory.set_metadata(directory.find("b").value(), 42, 7);
+    for (auto i = 0; i < 100; ++i) {
+      auto from = i % 2 == 0 ? "b" : ".b";
+      auto to = i % 2 == 0 ? ".b" : "b";
+      REQUIRE(directory.rename_entry(from, to).has_value());
+    }
+    directory.insert_entry("c", fs::file_type::regular);
+    directory.remove_entry("c");
+    CHECK(directory.table_.size() <= 2 * directory.all_entries_.size());
+    CHECK(names(directory.entries_) ==
+          std::vector<std::string_view>{"a_dir", "b"});
+    CHECK(names(directory.hidden_entries_) ==
+          std::vector<std::string_view>{".hidden"});
+    CHECK(names(directory.all_entries_) ==
+          std::vector<std::string_view>{"a_dir", ".hidden", "b"});
+    auto row = directory.find("b").value();
+    CHECK(directory.table_.file_size(row) == 42);
+    CHECK(directory.table_.mtime(row) == 7);
+    CHECK(directory.table_.is_directory(directory.find("a_dir").value()));
+  }
+}
+
+TEST_CASE("Directory Table Sort") {
+  duck::DirectoryTable table;
+  std::vector<duck::Row> rows;
+
+  SUBCASE("Shared prefixes fall back to names") {
+    for (auto name : {"prefix_long_b", "prefix_long_a", "prefix_l", "dir"}) {
+      rows.push_back(table.append(name, name == std::string_view{"dir"}
+                                            ? fs::file_type::directory
+                                            : fs::file_type::regular));
+    }
+    table.sort(rows);
+    std::vector<std::string_view> names;
+    for (auto entry : table.entries(rows)) {
+      names.push_back(entry.name());
+    }
+    CHECK(names == std::vector<std::string_view>{"dir", "prefix_l",
+                                                 "prefix_long_a",
+                                                 "prefix_long_b"});
+  }
+
+  SUBCASE("Parallel sort matches entries_sorter") {
+    for (size_t i = 0; i < duck::parallel_sort_threshold * 2; ++i) {
+      auto name = "entry_" + std::to_string((i * 7919) % 100003);
+      rows.push_back(table.append(name, i % 5 == 0 ? fs::file_type::directory
+                                                   : fs::file_type::regular));
+    }
+    table.sort(rows);
+    CHECK(std::ranges::is_sorted(rows, duck::entries_sorter,
+                                 [&table](duck::Row row) {
+                                   return table.entry(row);
+                                 }));
+  }
+
+  SUBCASE("Binary search insertion") {
+    for (auto name : {"a", "c", "e"}) {
+      rows.push_back(table.append(name, fs::file_type::regular));
+    }
+    table.insert_sorted(rows, table.append("d", fs::file_type::regular));
+    table.insert_sorted(rows, table.append("z", fs::file_type::directory));
+    std::vector<std::string_view> names;
+    for (auto entry : table.entries(rows)) {
+      names.push_back(entry.name());
+    }
+    CHECK(names == std::vector<std::string_view>{"z", "a", "c", "d", "e"});
+  }
+}
+
+TEST_CASE("Sort Modes") {
+  duck::Directory directory{.path_ = "/tmp"};
+  auto add = [&directory](std::string_view name, std::uint64_t size,
+                          std::int64_t mtime) {
+    auto row = directory.add_entry(name, fs::file_type::regular);
+    directory.table_.set_metadata(row, size, mtime);
+  };
+  add("file10.log", 10, 3);
+  add("file2.txt", 300, 1);
+  add("file1.log", 20, 2);
+  directory.add_entry("dir", fs::file_type::directory);
+
+  auto names = [&directory]() {
+    std::vector<std::string_view> result;
+    for (auto entry : directory.table_.entries(directory.entries_)) {
+      result.push_back(entry.name());
+    }
+    return result;
+  };
+
+  SUBCASE("Name") {
+    directory.set_sort_mode(duck::SortMode::Name);
+    CHECK(names() == std::vector<std::string_view>{"dir", "file1.log",
+                                                   "file10.log", "file2.txt"});
+  }
+
+  SUBCASE("Natural") {
+    directory.set_sort_mode(duck::SortMode::Natural);
+    CHECK(names() == std::vector<std::string_view>{"dir", "file1.log",
+                                                   "file2.txt", "file10.log"});
+  }
+
+  SUBCASE("Size") {
+    directory.set_sort_mode(duck::SortMode::Size);
+    CHECK(names() == std::vector<std::string_view>{"dir", "file10.log",
+                                                   "file1.log", "file2.txt"});
+  }
+
+  SUBCASE("Mtime newest first") {
+    directory.set_sort_mode(duck::SortMode::Mtime);
+    CHECK(names() == std::vector<std::string_view>{"dir", "file10.log",
+                                                   "file1.log", "file2.txt"});
+  }
+
+  SUBCASE("Extension") {
+    directory.set_sort_mode(duck::SortMode::Extension);
+    CHECK(names() == std::vector<std::string_view>{"dir", "file1.log",
+                                                   "file10.log", "file2.txt"});
+  }
+
+  SUBCASE("Insertion follows the mode") {
+    directory.set_sort_mode(duck::SortMode::Natural);
+    directory.insert_entry("file3.txt", fs::file_type::regular);
+    CHECK(names() ==
+          std::vector<std::string_view>{"dir", "file1.log", "file2.txt",
+                                        "file3.txt", "file10.log"});
+  }
+}
+
+TEST_CASE("File Classes") {
+  duck::DirectoryTable table;
+  auto dir = table.append("photos.png", fs::file_type::directory);
+  auto image = table.append("IMG_0001.JPG", fs::file_type::regular);
+  auto header = table.append("utils.hpp", fs::file_type::regular);
+  auto dotfile = table.append(".json", fs::file_type::regular);
+  auto broken = table.append("gone.txt", fs::file_type::not_found, true);
+
+  CHECK(table.file_class(dir) == duck::FileClass::Directory);
+  CHECK(table.file_class(image) == duck::FileClass::Image);
+  CHECK(table.file_class(header) == duck::FileClass::CppHeader);
+  CHECK(table.file_class(dotfile) == duck::FileClass::Other);
+  CHECK(table.file_class(broken) == duck::FileClass::Missing);
+
+  auto copy = duck::DirectoryTable::from_columns(
+      std::string{table.name_arena()},
+      {table.name_offsets().begin(), table.name_offsets().end()},
+      {table.kinds().begin(), table.kinds().end()}, {}, {});
+  REQUIRE(copy.has_value());
+  CHECK(copy.value().file_class(image) == duck::FileClass::Image);
+}
@@ -1,7 +1,51 @@
 #include "doctest.h"
 #include "file_manager.hpp"
 #include <filesystem>
+#include <fstream>
 
 namespace fs = std::filesystem;
 
-TEST_CASE("") {}
+TEST_CASE("Load Directory") {
+  auto root = fs::temp_directory_path() / "duck_load_directory_test";
+  fs::remove_all(root);
+  fs::create_directories(root / "b_dir");
+  std::ofstream(root / "a_file").close();
+  std::ofstream(root / ".hidden").close();
+  fs::create_symlink(root / "b_dir", root / "c_link");
+
+  auto directory = duck::FileManager::load_directory(root);
+  auto entry = [&directory](duck::Row row) { return directory.entry(row); };
+
+  SUBCASE("Splits hidden entries") {
+    REQUIRE(directory.entries_.size() == 3);
+    REQUIRE(directory.hidden_entries_.size() == 1);
+    CHECK(entry(directory.hidden_entries_[0]).path() == root / ".hidden");
+  }
+
+  SUBCASE("Types come from the listing") {
+    CHECK(entry(directory.entries_[0]).path() == root / "b_dir");
+    CHECK(entry(directory.entries_[0]).is_directory());
+    CHECK(entry(directory.entries_[1]).path() == root / "c_link");
+    CHECK(entry(directory.entries_[1]).is_directory());
+    CHECK(entry(directory.entries_[1]).is_symlink());
+    CHECK(entry(directory.entries_[2]).path() == root / "a_file");
+    CHECK(entry(directory.entries_[2]).type() == fs::file_type::regular);
+  }
+
+  SUBCASE("Bounded load gives up") {
+    auto never = []() { return false; };
+    auto always = []() { return true; };
+    auto bounded = duck::FileManager::load_directory_bounded(
+        root, duck::SortMode::Name, 4, never);
+    REQUIRE(bounded.has_value());
+    CHECK(bounded.value().entries_.size() == 3);
+    CHECK_FALSE(duck::FileManager::load_directory_bounded(
+                    root, duck::SortMode::Name, 3, never)
+                    .has_value());
+    CHECK_FALSE(duck::FileManager::load_directory_bounded(
+                    root, duck::SortMode::Name, 4, always)
+                    .has_value());
+  }
+
+  fs::remove_all(root);
+}
@@ -0,0 +1,73 @@
+#include "doctest.h"
+#include "hex_dump.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+TEST_CASE("Hex Dump") {
+  SUBCASE("Every byte value") {
+    std::vector<std::uint8_t> bytes(256);
+    std::string expected;
+    for (size_t i = 0; i < bytes.size(); ++i) {
+      bytes[i] = static_cast<std::uint8_t>(i);
+      expected += "0123456789abcdef"[i / 16];
+      expected += "0123456789abcdef"[i % 16];
+    }
+    std::string hex(bytes.size() * 2, ' ');
+    duck::encode_hex(bytes, hex.data());
+    CHECK(hex == expected);
+  }
+
+  SUBCASE("Rows") {
+    std::string text{"Hello, world!\n\x00\xff" "abc", 19};
+    std::vector<std::uint8_t> bytes(text.begin(), text.end());
+    auto lines = duck::hex_lines(bytes, 0x20, 16);
+    REQUIRE(lines.size() == 2);
+    CHECK(lines.line(0) == "00000020  48 65 6c 6c 6f 2c 20 77  6f 72 6c 64 21 "
+                           "0a 00 ff  |Hello, world!...|");
+    CHECK(lines.line(1) == "00000030  61 62 63" + std::string(42, ' ') +
+                               "|abc|");
+    CHECK(duck::hex_lines(bytes, 0xffffffff00, 16).line(0).starts_with(
+        "ffffffff00  48"));
+  }
+
+  SUBCASE("Narrow panes") {
+    CHECK(duck::hex_row_size(80) == 16);
+    CHECK(duck::hex_row_size(60) == 8);
+    CHECK(duck::hex_row_size(10) == 4);
+  }
+
+  SUBCASE("Offsets") {
+    CHECK(duck::parse_offset("0x1f0") == 0x1f0);
+    CHECK(duck::parse_offset(" 496 ") == 496);
+    CHECK_FALSE(duck::parse_offset("0x"));
+    CHECK_FALSE(duck::parse_offset("12ab"));
+    CHECK_FALSE(duck::parse_offset(""));
+  }
+
+  SUBCASE("Files are read from the offset") {
+    auto file = fs::temp_directory_path() / "duck_hex_dump_test";
+    {
+      std::ofstream out(file, std::ios::binary);
+      for (size_t i = 0; i < 4096; ++i) {
+        out.put(static_cast<char>(i / 16));
+      }
+    }
+    auto lines = duck::read_hex(file, 0x123, 80, 2);
+    REQUIRE(lines);
+    REQUIRE(lines->size() == 2);
+    CHECK(lines->line(0).starts_with("00000120  12 12"));
+    CHECK(lines->line(1).starts_with("00000130  13 13"));
+    // Past the end: the last row
+    auto end = duck::read_hex(file, 1 << 20U, 80, 2);
+    REQUIRE(end);
+    REQUIRE(end->size() == 1);
+    CHECK(end->line(0).starts_with("00000ff0  ff ff"));
+    CHECK_FALSE(duck::read_hex(file.string() + ".missing", 0, 80, 2));
+    fs::remove(file);
+  }
+}
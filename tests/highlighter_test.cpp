@@ -0,0 +1,121 @@
+#include "doctest.h"
+#include "highlighter.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using duck::Language;
+using duck::TokenKind;
+
+// Text and kind of every token of `text`, one line after the other
+std::vector<std::pair<std::string, TokenKind>>
+tokens(Language language, std::string_view text) {
+  auto lines = std::make_shared<const duck::TextLines>(
+      duck::split_lines(text, 200, 100));
+  auto highlighted = duck::highlight(lines, language, [] { return false; });
+  std::vector<std::pair<std::string, TokenKind>> result;
+  for (const auto &token : highlighted->tokens_) {
+    result.emplace_back(
+        lines->text_.substr(token.begin_, token.end_ - token.begin_),
+        token.kind_);
+  }
+  return result;
+}
+
+} // namespace
+
+TEST_CASE("Highlighter") {
+  using Tokens = std::vector<std::pair<std::string, TokenKind>>;
+
+  SUBCASE("Languages") {
+    CHECK(duck::detect_language("main.CPP", "") == Language::Cpp);
+    CHECK(duck::detect_language("setup.py", "") == Language::Python);
+    CHECK(duck::detect_language("run", "#!/usr/bin/env bash") ==
+          Language::Shell);
+    CHECK(duck::detect_language("tool", "#!/usr/bin/python3") ==
+          Language::Python);
+    CHECK(duck::detect_language("notes.txt", "") == Language::Plain);
+  }
+
+  SUBCASE("C++") {
+    CHECK(tokens(Language::Cpp, "#include <vector> // list\n"
+                                "int x = 0x1f; /* one\n"
+                                "two */ auto s = \"a\\\"b\";\n") ==
+          Tokens{{"#include <vector> ", TokenKind::Preprocessor},
+                 {"// list", TokenKind::Comment},
+                 {"int", TokenKind::Keyword},
+                 {"0x1f", TokenKind::Number},
+                 {"/* one", TokenKind::Comment},
+                 {"two */", TokenKind::Comment},
+                 {"auto", TokenKind::Keyword},
+                 {"\"a\\\"b\"", TokenKind::String}});
+  }
+
+  SUBCASE("Python") {
+    CHECK(tokens(Language::Python, "@cache\n"
+                                   "def f(x):  # doc\n"
+                                   "    \"\"\"Multi\n"
+                                   "    line\"\"\" + 'x'\n") ==
+          Tokens{{"@cache", TokenKind::Preprocessor},
+                 {"def", TokenKind::Keyword},
+                 {"# doc", TokenKind::Comment},
+                 {"\"\"\"Multi", TokenKind::String},
+                 {"    line\"\"\"", TokenKind::String},
+                 {"'x'", TokenKind::String}});
+  }
+
+  SUBCASE("JSON and YAML") {
+    CHECK(tokens(Language::Json, R"({"a": [1, -2.5, "b", true]})") ==
+          Tokens{{"\"a\"", TokenKind::Key},
+                 {"1", TokenKind::Number},
+                 {"-2.5", TokenKind::Number},
+                 {"\"b\"", TokenKind::String},
+                 {"true", TokenKind::Keyword}});
+    CHECK(tokens(Language::Yaml, "---\n"
+                                 "- name: duck # bird\n"
+                                 "  count: 3\n"
+                                 "  url: http://x\n") ==
+          Tokens{{"---", TokenKind::Keyword},
+                 {"-", TokenKind::Keyword},
+                 {"name", TokenKind::Key},
+                 {"# bird", TokenKind::Comment},
+                 {"count", TokenKind::Key},
+                 {"3", TokenKind::Number},
+                 {"url", TokenKind::Key}});
+  }
+
+  SUBCASE("Shell and Markdown") {
+    CHECK(tokens(Language::Shell,
+                 "if [ -n \"$x\" ]; then echo ${HOME} 'y'; fi # end") ==
+          Tokens{{"if", TokenKind::Keyword},
+                 {"\"$x\"", TokenKind::String},
+                 {"then", TokenKind::Keyword},
+                 {"${HOME}", TokenKind::Key},
+                 {"'y'", TokenKind::String},
+                 {"fi", TokenKind::Keyword},
+                 {"# end", TokenKind::Comment}});
+    CHECK(tokens(Language::Markdown, "# Title\n"
+                                     "- use `duck` **now**\n"
+                                     "```\n"
+                                     "code\n"
+                                     "```\n") ==
+          Tokens{{"# Title", TokenKind::Heading},
+                 {"-", TokenKind::Keyword},
+                 {"`duck`", TokenKind::Code},
+                 {"**now**", TokenKind::Keyword},
+                 {"```", TokenKind::Code},
+                 {"code", TokenKind::Code},
+                 {"```", TokenKind::Code}});
+  }
+
+  SUBCASE("Stopping") {
+    auto lines = std::make_shared<const duck::TextLines>(
+        duck::split_lines("a\nb\nc\n", 80, 10));
+    CHECK(duck::highlight(lines, Language::Cpp, [] { return false; }));
+    CHECK_FALSE(duck::highlight(lines, Language::Cpp, [] { return true; }));
+  }
+}
@@ -0,0 +1,110 @@
+#include "doctest.h"
+#include "image_preview.hpp"
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <png.h>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::span<const std::uint8_t> bytes(std::string_view text) {
+  return {reinterpret_cast<const std::uint8_t *>(text.data()), text.size()};
+}
+
+std::array<std::uint8_t, 4> pixel(const duck::Image &image, std::uint32_t x,
+                                  std::uint32_t y) {
+  const auto *data = image.pixel(x, y);
+  return {data[0], data[1], data[2], data[3]};
+}
+
+} // namespace
+
+TEST_CASE("Image Preview") {
+  using namespace std::string_view_literals;
+  using Pixel = std::array<std::uint8_t, 4>;
+  auto never = []() { return false; };
+
+  SUBCASE("Fitting the box") {
+    CHECK(duck::fit_size(1000, 500, 100, 100) == std::pair{100U, 50U});
+    CHECK(duck::fit_size(300, 900, 100, 100) == std::pair{33U, 100U});
+    CHECK(duck::fit_size(16, 16, 100, 100) == std::pair{16U, 16U});
+    CHECK(duck::fit_size(4000, 1, 10, 10) == std::pair{10U, 1U});
+  }
+
+  SUBCASE("GIF") {
+    // 4x2, palette red, green, blue, black with black transparent:
+    // 0 0 1 3 over 2 2 2 2
+    auto gif = "GIF89a\x04\x00\x02\x00\x81\x00\x00"
+               "\xff\x00\x00\x00\xff\x00\x00\x00\xff\x00\x00\x00"
+               "\x21\xf9\x04\x01\x00\x00\x03\x00"
+               "\x2c\x00\x00\x00\x00\x04\x00\x02\x00\x00"
+               "\x02\x04\x04\x32\xa2\x52\x00\x3b"sv;
+    auto image = duck::decode_gif(bytes(gif));
+    REQUIRE(image);
+    CHECK(image->width_ == 4);
+    CHECK(image->height_ == 2);
+    CHECK(pixel(*image, 0, 0) == Pixel{0xff, 0, 0, 0xff});
+    CHECK(pixel(*image, 2, 0) == Pixel{0, 0xff, 0, 0xff});
+    CHECK(pixel(*image, 3, 0)[3] == 0);
+    CHECK(pixel(*image, 3, 1) == Pixel{0, 0, 0xff, 0xff});
+    CHECK_FALSE(duck::decode_gif(bytes("GIF89a\x04\x00"sv)));
+  }
+
+  SUBCASE("Netpbm") {
+    auto ppm = duck::decode_netpbm(
+        bytes("P6\n# comment\n2 1\n255\n\xff\x80\x00\x00\x00\xff"sv));
+    REQUIRE(ppm);
+    CHECK(pixel(*ppm, 0, 0) == Pixel{0xff, 0x80, 0, 0xff});
+    CHECK(pixel(*ppm, 1, 0) == Pixel{0, 0, 0xff, 0xff});
+    auto pgm = duck::decode_netpbm(bytes("P5 1 1 1023\n\x03\xff"sv));
+    REQUIRE(pgm);
+    CHECK(pixel(*pgm, 0, 0) == Pixel{0xff, 0xff, 0xff, 0xff});
+    CHECK_FALSE(duck::decode_netpbm(bytes("P6\n2 1\n255\n\xff"sv)));
+    CHECK_FALSE(duck::decode_netpbm(bytes("P3\n1 1\n255\n0 0 0"sv)));
+  }
+
+  SUBCASE("Resizing averages") {
+    // Columns of 0 and 100 in every channel, wider than one SIMD block
+    duck::Image image{.width_ = 8, .height_ = 2};
+    for (size_t x = 0; x < 16; ++x) {
+      for (size_t channel = 0; channel < 4; ++channel) {
+        image.pixels_.push_back(x % 2 == 0 ? 0 : 100);
+      }
+    }
+    auto resized = duck::resize_image(image, 4, 1);
+    CHECK(resized.width_ == 4);
+    CHECK(resized.height_ == 1);
+    for (std::uint32_t x = 0; x < 4; ++x) {
+      CHECK(pixel(resized, x, 0) == Pixel{50, 50, 50, 50});
+    }
+    CHECK(duck::resize_image(image, 20, 20).pixels_ == image.pixels_);
+  }
+
+  SUBCASE("Files are fitted to the box") {
+    auto file = fs::temp_directory_path() / "duck_image_preview_test.png";
+    std::vector<std::uint8_t> rgba(size_t{64} * 32 * 4, 0xff);
+    png_image png{};
+    png.version = PNG_IMAGE_VERSION;
+    png.width = 64;
+    png.height = 32;
+    png.format = PNG_FORMAT_RGBA;
+    REQUIRE(png_image_write_to_file(&png, file.c_str(), 0, rgba.data(), 0,
+                                    nullptr) != 0);
+    auto image =
+        duck::decode_image(file, duck::ContentType::Png, 16, 16, never);
+    REQUIRE(image);
+    CHECK(image->width_ == 16);
+    CHECK(image->height_ == 8);
+    CHECK(pixel(*image, 15, 7) == Pixel{0xff, 0xff, 0xff, 0xff});
+    CHECK_FALSE(duck::decode_image(file, duck::ContentType::Png, 16, 16,
+                                   []() { return true; }));
+    CHECK_FALSE(duck::decode_image(file, duck::ContentType::Jpeg, 16, 16,
+                                   never));
+    fs::remove(file);
+  }
+}
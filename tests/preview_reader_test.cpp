@@ -0,0 +1,79 @@
+#include "byte_scan.hpp"
+#include "doctest.h"
+#include "preview_reader.hpp"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+TEST_CASE("Preview Reader") {
+  using namespace std::string_view_literals;
+
+  SUBCASE("Byte scanning") {
+    auto bytes = std::string(40, 'a') + "\n" + std::string(3, 'b') + "\n";
+    CHECK(duck::find_byte(bytes, '\n') == 40);
+    CHECK(duck::find_byte(bytes, '\n', 41) == 44);
+    CHECK(duck::find_byte(bytes, 'z') == bytes.size());
+    CHECK(duck::is_printable_ascii(std::string(33, 'x')));
+    CHECK_FALSE(duck::is_printable_ascii(std::string(20, 'x') + "\t"));
+    CHECK_FALSE(duck::is_printable_ascii(std::string(9, 'x') + "\x7f"));
+    CHECK_FALSE(duck::is_printable_ascii("Ümlaut, long enough for a block"));
+  }
+
+  SUBCASE("Lines share one buffer") {
+    auto lines = duck::split_lines("first\r\nsecond\n\nlast", 80, 10);
+    REQUIRE(lines.size() == 4);
+    CHECK(lines.line(0) == "first");
+    CHECK(lines.line(1) == "second");
+    CHECK(lines.line(2).empty());
+    CHECK(lines.line(3) == "last");
+    CHECK(lines.text_ == "firstsecondlast");
+  }
+
+  SUBCASE("Only `rows` lines are taken") {
+    auto lines = duck::split_lines("1\n2\n3\n4\n", 80, 2);
+    REQUIRE(lines.size() == 2);
+    CHECK(lines.line(1) == "2");
+  }
+
+  SUBCASE("Long lines are cut at the display width") {
+    auto lines = duck::split_lines(std::string(100, 'a'), 10, 5);
+    REQUIRE(lines.size() == 1);
+    CHECK(lines.line(0) == "aaaaaaa...");
+    CHECK(duck::split_lines("0123456789", 10, 1).line(0) == "0123456789");
+  }
+
+  SUBCASE("UTF-8 is cut between characters") {
+    // Two columns per character
+    auto wide = duck::split_lines("日本語のテキスト", 10, 1);
+    CHECK(wide.line(0) == "日本語...");
+    auto accented = duck::split_lines("ééééééééééé", 10, 1);
+    CHECK(accented.line(0) == "ééééééé...");
+    // Combining acute accents take no columns
+    auto combined = duck::split_lines("e\xcc\x81" "e\xcc\x81", 2, 1);
+    CHECK(combined.line(0) == "e\xcc\x81" "e\xcc\x81");
+  }
+
+  SUBCASE("Tabs and control bytes") {
+    CHECK(duck::split_lines("\tx", 80, 1).line(0) == "        x");
+    CHECK(duck::split_lines("a\x1b[0m", 80, 1).line(0) == "a\xef\xbf\xbd[0m");
+    CHECK(duck::split_lines("\xff", 80, 1).line(0) == "\xef\xbf\xbd");
+  }
+
+  SUBCASE("Files are read up to the window") {
+    auto file = fs::temp_directory_path() / "duck_preview_reader_test";
+    {
+      std::ofstream out(file, std::ios::binary);
+      out << "header\n" << std::string(duck::preview_window_size * 2, 'x');
+    }
+    auto lines = duck::read_preview(file, 20, 5);
+    REQUIRE(lines);
+    REQUIRE(lines->size() == 2);
+    CHECK(lines->line(0) == "header");
+    CHECK(lines->line(1) == "xxxxxxxxxxxxxxxxx...");
+    CHECK_FALSE(duck::read_preview(file.string() + ".missing", 20, 5));
+    fs::remove(file);
+  }
+}
@@ -0,0 +1,113 @@
+#include "doctest.h"
+#include "file_manager.hpp"
+#include "snapshot.hpp"
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+namespace fs = std::filesystem;
+
+TEST_CASE("Snapshot") {
+  auto root = fs::temp_directory_path() / "duck_snapshot_test";
+  fs::remove_all(root);
+  fs::create_directories(root / "listing" / "b_dir");
+  std::ofstream(root / "listing" / "a_file").close();
+  std::ofstream(root / "listing" / ".hidden").close();
+  auto file = root / "snapshot";
+
+  duck::Snapshot snapshot;
+  snapshot.session_ = {.current_path_ = root / "listing",
+                       .focused_name_ = "a_file",
+                       .index_ = 1,
+                       .show_hidden_ = true,
+                       .sort_mode_ = duck::SortMode::Size,
+                       .selected_ = {duck::Entry{root / "listing" / "b_dir",
+                                                 fs::file_type::directory}}};
+  snapshot.directories_.push_back(
+      std::make_shared<const duck::Directory>(duck::FileManager::load_directory(
+          root / "listing", duck::SortMode::Size)));
+  snapshot.directories_.push_back(std::make_shared<const duck::Directory>(
+      duck::Directory{.path_ = root / "unstamped"}));
+  REQUIRE(duck::write_snapshot(file, snapshot));
+
+  SUBCASE("Round trip") {
+    auto restored = duck::read_snapshot(file);
+    REQUIRE(restored.has_value());
+    const auto &session = restored.value().session_;
+    CHECK(session.current_path_ == root / "listing");
+    CHECK(session.focused_name_ == "a_file");
+    CHECK(session.index_ == 1);
+    CHECK(session.show_hidden_);
+    CHECK(session.sort_mode_ == duck::SortMode::Size);
+    REQUIRE(session.selected_.size() == 1);
+    CHECK(session.selected_[0].is_directory());
+
+    // Unstamped directories can't be revalidated and are skipped
+    REQUIRE(restored.value().directories_.size() == 1);
+    const auto &original = *snapshot.directories_[0];
+    const auto &directory = *restored.value().directories_[0];
+    CHECK(directory.stamp_ == original.stamp_);
+    CHECK(directory.sort_mode_ == duck::SortMode::Size);
+    CHECK(directory.entries_ == original.entries_);
+    CHECK(directory.hidden_entries_ == original.hidden_entries_);
+    CHECK(directory.all_entries_ == original.all_entries_);
+    CHECK(directory.table_.has_metadata());
+    CHECK(directory.entry(directory.entries_[0]).path() ==
+          root / "listing" / "b_dir");
+    CHECK(directory.table_.is_directory(directory.entries_[0]));
+  }
+
+  SUBCASE("Removed entries") {
+    auto changed = *snapshot.directories_[0];
+    changed.remove_entry("a_file");
+    // Still in the table, too few to compact it
+    REQUIRE(changed.table_.size() > changed.all_entries_.size());
+    snapshot.directories_ = {std::make_shared<const duck::Directory>(changed)};
+    REQUIRE(duck::write_snapshot(file, snapshot));
+
+    auto restored = duck::read_snapshot(file);
+    REQUIRE(restored.has_value());
+    REQUIRE(restored.value().directories_.size() == 1);
+    const auto &directory = *restored.value().directories_[0];
+    CHECK(directory.table_.size() == 2);
+    REQUIRE(directory.all_entries_.size() == 2);
+    CHECK(directory.table_.name(directory.all_entries_[0]) == "b_dir");
+    CHECK(directory.table_.name(directory.all_entries_[1]) == ".hidden");
+  }
+
+  SUBCASE("Broken directories are skipped") {
+    // Lists its only row twice
+    duck::Directory broken{.path_ = root / "broken",
+                           .stamp_ = duck::DirectoryStamp{}};
+    broken.add_entry("x", fs::file_type::regular);
+    broken.entries_.push_back(broken.entries_[0]);
+    snapshot.directories_.insert(
+        snapshot.directories_.begin(),
+        std::make_shared<const duck::Directory>(std::move(broken)));
+    REQUIRE(duck::write_snapshot(file, snapshot));
+
+    auto restored = duck::read_snapshot(file);
+    REQUIRE(restored.has_value());
+    CHECK(restored.value().session_.focused_name_ == "a_file");
+    REQUIRE(restored.value().directories_.size() == 1);
+    CHECK(restored.value().directories_[0]->path_ == root / "listing");
+  }
+
+  SUBCASE("Stamp follows changes") {
+    CHECK(duck::stamp_directory(root / "listing") ==
+          snapshot.directories_[0]->stamp_);
+    std::ofstream(root / "listing" / "c_file").close();
+    CHECK(duck::stamp_directory(root / "listing") !=
+          snapshot.directories_[0]->stamp_);
+  }
+
+  SUBCASE("Damaged files are rejected") {
+    fs::resize_file(file, fs::file_size(file) - 3);
+    CHECK_FALSE(duck::read_snapshot(file).has_value());
+    std::ofstream(file, std::ios::trunc) << "not a snapshot";
+    CHECK_FALSE(duck::read_snapshot(file).has_value());
+    CHECK_FALSE(duck::read_snapshot(root / "missing").has_value());
+  }
+
+  fs::remove_all(root);
+}
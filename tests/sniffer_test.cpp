@@ -0,0 +1,71 @@
+#include "doctest.h"
+#include "sniffer.hpp"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+duck::ContentType sniff(std::string_view bytes) {
+  return duck::sniff_bytes(
+      {reinterpret_cast<const unsigned char *>(bytes.data()), bytes.size()});
+}
+
+bool is_text(std::string_view bytes) {
+  return duck::is_text(
+      {reinterpret_cast<const unsigned char *>(bytes.data()), bytes.size()});
+}
+
+} // namespace
+
+TEST_CASE("Content Sniffer") {
+  using duck::ContentType;
+  using namespace std::string_view_literals;
+
+  SUBCASE("Magic numbers") {
+    CHECK(sniff("\x89PNG\r\n\x1a\n rest"sv) == ContentType::Png);
+    CHECK(sniff("GIF89a"sv) == ContentType::Gif);
+    CHECK(sniff("%PDF-1.7\n"sv) == ContentType::Pdf);
+    CHECK(sniff("\x7f"
+                "ELF\x02\x01"sv) == ContentType::Elf);
+    CHECK(sniff("P6\n640 480\n255\n"sv) == ContentType::Netpbm);
+    CHECK(sniff(std::string(257, '\0') + "ustar") == ContentType::Tar);
+  }
+
+  SUBCASE("Text") {
+    CHECK(sniff("") == ContentType::Empty);
+    CHECK(sniff("int main() {\n\treturn 0;\n}\n") == ContentType::Text);
+    CHECK(sniff("Pinguin mit Schnee: ❄ und Ümlaute\n") == ContentType::Text);
+    CHECK(sniff("\x1b[1mbold\x1b[0m, long enough for a full block\n") ==
+          ContentType::Text);
+  }
+
+  SUBCASE("Binary") {
+    CHECK(sniff("text with a \0 in the middle of a block"sv) ==
+          ContentType::Binary);
+    // Overlong '/', a UTF-16 surrogate and a lone continuation byte
+    CHECK_FALSE(is_text("\xc0\xaf"));
+    CHECK_FALSE(is_text("\xed\xa0\x80"));
+    CHECK_FALSE(is_text("abc\x80"));
+  }
+
+  SUBCASE("A sequence cut off at the end is text") {
+    CHECK(is_text("0123456789abcdef\xe2\x9d"));
+  }
+
+  SUBCASE("Cached by identity") {
+    auto file = fs::temp_directory_path() / "duck_sniffer_test";
+    std::ofstream(file) << "plain text\n";
+    duck::ContentSniffer sniffer;
+    CHECK(sniffer.sniff(file) == ContentType::Text);
+
+    std::ofstream(file, std::ios::binary) << "\x89PNG\r\n\x1a\n and more";
+    CHECK(sniffer.sniff(file) == ContentType::Png);
+    CHECK(sniffer.sniff(file.string() + ".missing") ==
+          ContentType::Unreadable);
+    fs::remove(file);
+  }
+}
@@ -1,5 +1,8 @@
 #include "doctest.h"
 #include "utils.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
 
 TEST_CASE("LRU Cache") {
   duck::Lru<int, std::string> cache(2);
@@ -26,12 +29,158 @@ TEST_CASE("LRU Cache") {
     cache.insert(1, "new_one");
     CHECK(cache.get(1) == "new_one");
   }
+
+  SUBCASE("Peek leaves recency alone") {
+    cache.insert(1, "one");
+    cache.insert(2, "two");
+    CHECK(cache.peek(1, [](const std::string &value) {
+      return value.size();
+    }) == 3);
+    CHECK(cache.contains(1));
+    CHECK_FALSE(cache.peek(3, [](const std::string &value) {
+                       return value.size();
+                     }).has_value());
+    cache.insert(3, "three");
+    CHECK_FALSE(cache.contains(1));
+    CHECK(cache.keys() == std::vector<int>{3, 2});
+  }
+}
+
+TEST_CASE("Weighted LRU Cache") {
+  duck::Lru<int, std::string> cache(
+      10, 8, [](const std::string &value) { return value.size(); });
+
+  SUBCASE("Evicts by weight") {
+    cache.insert(1, "abc");
+    cache.insert(2, "def");
+    CHECK(cache.weight() == 6);
+    cache.insert(3, "ghi");
+    CHECK_FALSE(cache.contains(1));
+    CHECK(cache.weight() == 6);
+  }
+
+  SUBCASE("Replacing a value updates its weight") {
+    cache.insert(1, "abc");
+    cache.insert(1, "a");
+    CHECK(cache.weight() == 1);
+  }
+
+  SUBCASE("Keeps a value over budget") {
+    cache.insert(1, "abc");
+    cache.insert(2, "longer than the budget");
+    CHECK(cache.keys() == std::vector<int>{2});
+  }
+
+  SUBCASE("Shrinks on demand") {
+    cache.insert(1, "ab");
+    cache.insert(2, "cd");
+    cache.insert(3, "ef");
+    cache.shrink_to(3);
+    CHECK(cache.keys() == std::vector<int>{3});
+    cache.set_budget(2);
+    cache.insert(4, "gh");
+    CHECK(cache.keys() == std::vector<int>{4});
+  }
+}
+
+TEST_CASE("2Q Cache") {
+  duck::Lru<int, std::string, duck::Eviction::TwoQueue> cache(4);
+  for (int key = 1; key <= 5; ++key) {
+    cache.insert(key, std::to_string(key));
+  }
+  CHECK_FALSE(cache.contains(1));
+
+  SUBCASE("Returning keys survive a scan") {
+    cache.insert(1, "1");
+    for (int key = 10; key < 20; ++key) {
+      cache.insert(key, std::to_string(key));
+    }
+    CHECK(cache.get(1) == "1");
+    CHECK(cache.keys().front() == 1);
+  }
+
+  SUBCASE("Keys seen once stay on probation") {
+    CHECK(cache.get(5) == "5");
+    for (int key = 10; key < 20; ++key) {
+      cache.insert(key, std::to_string(key));
+    }
+    CHECK_FALSE(cache.contains(5));
+  }
+
+  SUBCASE("Pinned keys survive a scan") {
+    cache.pin({5, 7});
+    auto kept = true;
+    for (int key = 10; key < 600; ++key) {
+      cache.insert(key, std::to_string(key));
+      kept = kept && cache.get(5) == "5";
+    }
+    CHECK(kept);
+    cache.insert(7, "7");
+    for (int key = 600; key < 610; ++key) {
+      cache.insert(key, std::to_string(key));
+    }
+    CHECK(cache.contains(7));
+    cache.shrink_to(0);
+    CHECK(cache.contains(5));
+    CHECK(cache.contains(7));
+    // Each queue keeps its newest key
+    cache.pin({});
+    cache.shrink_to(0);
+    CHECK(cache.keys().size() == 2);
+  }
+}
+
+TEST_CASE("Sharded LRU Cache") {
+  SUBCASE("Referenced values get a second chance") {
+    duck::ShardedLru<int, std::string> cache(2, 1);
+    cache.insert(1, "one");
+    cache.insert(2, "two");
+    CHECK(cache.get(1) == "one");
+    cache.insert(3, "three");
+    CHECK(cache.contains(1));
+    CHECK_FALSE(cache.contains(2));
+    CHECK(cache.get(3) == "three");
+  }
+
+  SUBCASE("Replacing keeps the size") {
+    duck::ShardedLru<int, std::string> cache(4, 1);
+    cache.insert(1, "one");
+    cache.insert(1, "uno");
+    CHECK(cache.size() == 1);
+    CHECK(cache.peek(1, [](const std::string &value) {
+      return value;
+    }) == "uno");
+  }
+
+  SUBCASE("Concurrent access stays bounded") {
+    duck::ShardedLru<int, int> cache(64, 4);
+    std::vector<std::jthread> threads;
+    std::atomic<bool> consistent = true;
+    for (int thread = 0; thread < 4; ++thread) {
+      threads.emplace_back([&cache, &consistent, thread] {
+        for (int i = 0; i < 10000; ++i) {
+          auto key = (i * 7 + thread) % 256;
+          if (auto value = cache.get(key); value && value.value() != key) {
+            consistent = false;
+          }
+          cache.insert(key, key);
+        }
+      });
+    }
+    threads.clear();
+    CHECK(consistent);
+    CHECK(cache.size() <= cache.capacity());
+  }
 }
 
 TEST_CASE("Entries Sorter") {
-  auto dir = std::filesystem::directory_entry("a_dir");
-  auto file1 = std::filesystem::directory_entry("b_file");
-  auto file2 = std::filesystem::directory_entry("c_file");
+  duck::DirectoryTable table;
+  auto dir = table.entry(
+      table.append("z_dir", std::filesystem::file_type::directory));
+  auto file1 =
+      table.entry(table.append("b_file", std::filesystem::file_type::regular));
+  auto file2 =
+      table.entry(table.append("c_file", std::filesystem::file_type::regular));
 
   SUBCASE("Directories first") {
     CHECK(duck::entries_sorter(dir, file1) == true);
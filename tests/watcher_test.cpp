@@ -0,0 +1,72 @@
+#include "doctest.h"
+#include "event_bus.hpp"
+#include "watcher.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::vector<duck::FsChange> next_changes(duck::EventBus &event_bus) {
+  auto event = event_bus.pop_event_with_timeout(std::chrono::seconds{2});
+  REQUIRE(event.has_value());
+  REQUIRE(std::holds_alternative<duck::DirectoryChanged>(event.value()));
+  const auto &changed = std::get<duck::DirectoryChanged>(event.value());
+  // Restamped so that patched listings don't look stale afterwards
+  CHECK(changed.stamp_ == duck::stamp_directory(changed.path_));
+  return changed.changes_;
+}
+
+} // namespace
+
+TEST_CASE("Watcher") {
+  auto root = fs::temp_directory_path() / "duck_watcher_test";
+  fs::remove_all(root);
+  fs::create_directories(root);
+
+  duck::EventBus event_bus;
+  duck::Watcher watcher{event_bus};
+  watcher.watch({root});
+  REQUIRE(watcher.watched() == std::vector<fs::path>{root});
+
+  SUBCASE("Batches a burst of creations") {
+    fs::create_directory(root / "a_dir");
+    std::ofstream(root / "b_file").close();
+
+    auto changes = next_changes(event_bus);
+    auto created = std::ranges::count(changes, duck::FsChange::Type::Created,
+                                      &duck::FsChange::type_);
+    CHECK(created == 2);
+    CHECK(changes[0].name_ == "a_dir");
+    CHECK(changes[0].file_type_ == fs::file_type::directory);
+  }
+
+  SUBCASE("Pairs moves into renames") {
+    std::ofstream(root / "old").close();
+    next_changes(event_bus);
+
+    fs::rename(root / "old", root / "new");
+    auto changes = next_changes(event_bus);
+    REQUIRE(changes.size() == 1);
+    CHECK(changes[0].type_ == duck::FsChange::Type::Renamed);
+    CHECK(changes[0].name_ == "old");
+    CHECK(changes[0].new_name_ == "new");
+    CHECK(changes[0].file_type_ == fs::file_type::regular);
+  }
+
+  SUBCASE("Reports deletions") {
+    fs::create_directory(root / "gone");
+    next_changes(event_bus);
+
+    fs::remove(root / "gone");
+    auto changes = next_changes(event_bus);
+    REQUIRE(changes.size() == 1);
+    CHECK(changes[0].type_ == duck::FsChange::Type::Deleted);
+  }
+
+  watcher.watch({});
+  CHECK(watcher.watched().empty());
+  fs::remove_all(root);
+}